@@ -0,0 +1,64 @@
+//OlcBptree 多线程 micro-benchmark：1..T 个线程同时插入、点查、区间查，核对结果并输出每秒操作数
+//插入阶段每个线程插自己那份键（交错分配，叶子上互相竞争），查询阶段每个线程查全部键里的随机位置
+
+#include "../db/olc_bpt.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+typedef std::pair<unsigned long long, int> Key;
+struct Value {
+    int status, a, b, c, d, e, f;
+};
+
+template<class F>
+double timeIt(int threads, F f) { //f(线程号)，返回秒数
+    auto st = std::chrono::steady_clock::now();
+    std::thread* pool = new std::thread[threads];
+    for (int i = 1; i < threads; ++i) pool[i] = std::thread(f, i);
+    f(0);
+    for (int i = 1; i < threads; ++i) pool[i].join();
+    delete[] pool;
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+}
+
+int main(int argc, char** argv) {
+    int n = (argc > 1) ? atoi(argv[1]) : 200000, maxThreads = (argc > 2) ? atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+    auto keyOf = [](int i) {return Key((unsigned long long)(i % 1000) * 0x9E3779B97F4A7C15ull, i);}; //1000 个“用户”，各自的订单连续
+    printf("%8s %12s %12s %12s %8s\n", "threads", "insert/s", "find/s", "range/s", "errors");
+    for (int threads = 1; threads <= std::max(maxThreads, 1); threads <<= 1) {
+        remove("olc_bench.bin");
+        OlcBptree<Key, Value> tree("olc_bench.bin", 1024);
+        std::atomic<int> errors(0);
+        double insertTime = timeIt(threads, [&](int id) {
+            for (int i = id; i < n; i += threads)
+                if (!tree.insert(keyOf(i), (Value){i, 0, 0, 0, 0, 0, i})) ++errors;
+        });
+        if (tree.size() != n) ++errors;
+        double findTime = timeIt(threads, [&](int id) {
+            unsigned seed = id * 7919 + 1;
+            for (int k = 0; k < n / threads; ++k) {
+                seed = seed * 1103515245 + 12345;
+                int i = seed % n;
+                auto ret = tree.find(keyOf(i));
+                if (!ret.second || ret.first.status != i || ret.first.f != i) ++errors;
+            }
+        });
+        int ranges = n / 100;
+        double rangeTime = timeIt(threads, [&](int id) {
+            Value* got = new Value[n / 1000 + 1];
+            for (int k = id; k < ranges; k += threads) {
+                unsigned long long user = (unsigned long long)(k % 1000) * 0x9E3779B97F4A7C15ull;
+                int cnt = 0;
+                tree.range_find(Key(user, 0), Key(user, n), [&]() {return &got[cnt++];});
+                int expect = n / 1000 + (k % 1000 < n % 1000);
+                if (cnt != expect) {++errors; continue;}
+                for (int j = 0; j < cnt; ++j) if (got[j].status != k % 1000 + j * 1000) {++errors; break;}
+            }
+            delete[] got;
+        });
+        printf("%8d %12.0f %12.0f %12.0f %8d\n", threads, n / insertTime, (n / threads * threads) / findTime, ranges / rangeTime, errors.load());
+    }
+    remove("olc_bench.bin");
+    return 0;
+}
@@ -0,0 +1,129 @@
+//seat kernels micro-benchmark: 标量 / SIMD 扫描 vs 懒标记线段树
+//每个 "session" 模拟一次对某车次某天的使用：读出一行，做 ops 次随机区间查询（每 4 次夹一次区间加），写回
+//输出每个 session 的纳秒数，找出线段树开始占优的段数
+
+#include "../lib/seatops.hpp"
+#include <chrono>
+
+using namespace Sirius;
+
+/* 区间加、区间 min 的懒标记线段树（自底向上，非递归）
+ * t[p] 是子树最小值（已含 p 自己的标记 d[p]），叶子补到 2 的幂，多余叶子为 Int_Max
+ */
+template<int N>
+class SeatSegTree {
+private:
+    static constexpr int Size = (N <= 1) ? 1 : 1 << (32 - __builtin_clz(N - 1));
+    int n, h, t[Size << 1], d[Size];
+
+    void apply(int p, int val) {
+        t[p] += val;
+        if (p < n) d[p] += val;
+    }
+    void pull(int p) {
+        while (p > 1) p >>= 1, t[p] = std::min(t[p<<1], t[p<<1|1]) + d[p];
+    }
+    void push(int p) {
+        for (int s = h; s > 0; --s) {
+            int i = p >> s;
+            if (d[i]) apply(i<<1, d[i]), apply(i<<1|1, d[i]), d[i] = 0;
+        }
+    }
+public:
+    void build(const int* a, int len) {
+        n = 1, h = 0;
+        while (n < len) n <<= 1, ++h;
+        for (int i = 0; i < n; ++i) t[n+i] = (i < len) ? a[i] : Int_Max;
+        for (int i = n-1; i > 0; --i) t[i] = std::min(t[i<<1], t[i<<1|1]), d[i] = 0;
+    }
+    int query(int l, int r) { //闭区间
+        l += n, r += n+1;
+        push(l), push(r-1);
+        int ret = Int_Max;
+        for (; l < r; l >>= 1, r >>= 1) {
+            if (l&1) ret = std::min(ret, t[l++]);
+            if (r&1) ret = std::min(ret, t[--r]);
+        }
+        return ret;
+    }
+    void modify(int l, int r, int val) { //闭区间
+        l += n, r += n+1;
+        int l0 = l, r0 = r;
+        for (; l < r; l >>= 1, r >>= 1) {
+            if (l&1) apply(l++, val);
+            if (r&1) apply(--r, val);
+        }
+        pull(l0), pull(r0-1);
+    }
+    void flatten(int* a, int len) { //标记全部下放，写回一行
+        for (int i = 1; i < n; ++i)
+            if (d[i]) apply(i<<1, d[i]), apply(i<<1|1, d[i]), d[i] = 0;
+        for (int i = 0; i < len; ++i) a[i] = t[n+i];
+    }
+};
+
+constexpr int Seg_Max = 128, Row_Num = 1024;
+int rows[Row_Num][Seg_Max], work[Seg_Max];
+int qs[4096][2];
+volatile int sink;
+
+template<class F>
+double timeIt(F f, int rounds) {
+    auto st = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) f(i);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - st).count() / rounds;
+}
+
+int main(int argc, char** argv) {
+    int rounds = (argc > 1) ? atoi(argv[1]) : 20000;
+    srand(2021);
+    for (auto& row : rows) for (int& x : row) x = randInt(50000, 100000);
+#ifdef SIRIUS_X86_SIMD
+    printf("simd level: %d\n", simdLevel());
+#else
+    printf("simd level: 0\n");
+#endif
+    const int opsList[] = {1, 4, 16, 64};
+    for (int ops : opsList) {
+        printf("ops/session = %d\n%6s %10s %10s %10s\n", ops, "segs", "scalar", "simd", "segtree");
+        int crossover = -1;
+        for (int n = 4; n <= 100; n += (n < 16) ? 4 : 8) {
+            for (auto& q : qs) {
+                q[0] = randInt(0, n-1), q[1] = randInt(0, n-1);
+                if (q[0] > q[1]) std::swap(q[0], q[1]);
+            }
+            auto flat = [&](int i, int (*mn)(const int*, int, int), void (*add)(int*, int, int, int)) {
+                int* row = rows[i % Row_Num];
+                memcpy(work, row, n * sizeof(int));
+                int acc = 0;
+                for (int k = 0; k < ops; ++k) {
+                    const int* q = qs[(i * ops + k) & 4095];
+                    acc += mn(work, q[0], q[1]);
+                    if ((k & 3) == 0) add(work, q[0], q[1], -1);
+                }
+                memcpy(row, work, n * sizeof(int));
+                sink = acc;
+            };
+            double tScalar = timeIt([&](int i) {flat(i, rangeMinScalar, rangeAddScalar);}, rounds);
+            double tSimd = timeIt([&](int i) {flat(i, rangeMin, rangeAdd);}, rounds);
+            SeatSegTree<Seg_Max> tree;
+            double tTree = timeIt([&](int i) {
+                int* row = rows[i % Row_Num];
+                tree.build(row, n);
+                int acc = 0;
+                for (int k = 0; k < ops; ++k) {
+                    const int* q = qs[(i * ops + k) & 4095];
+                    acc += tree.query(q[0], q[1]);
+                    if ((k & 3) == 0) tree.modify(q[0], q[1], -1);
+                }
+                tree.flatten(row, n);
+                sink = acc;
+            }, rounds);
+            if (crossover == -1 && tTree < tSimd) crossover = n;
+            printf("%6d %10.1f %10.1f %10.1f\n", n, tScalar, tSimd, tTree);
+        }
+        if (crossover == -1) printf("segtree never faster than simd up to 100 segments\n\n");
+        else printf("segtree faster than simd from %d segments\n\n", crossover);
+    }
+    return 0;
+}
@@ -8,6 +8,9 @@
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <type_traits>
+#include <algorithm>
+#include <mutex>
 #include "hash_map.h"
 
 //long long
@@ -18,10 +21,29 @@ int bug_num=0;
 int split_num=0;
 int delete_num=0;
 
+    //变长value：Value 提供 packedSize/pack/unpack 时，value文件按 size class 分槽存储
+    //槽 = [int len][payload]，槽大小为 Slot_Min<<cls，槽首 32 对齐，所以 cls 直接编进 offset 的低 5 位
+    template<class T>
+    class packed_value{
+        template<class U> static char check(decltype(&U::packedSize));
+        template<class U> static int check(...);
+    public:
+        static const bool value = sizeof(check<T>(nullptr)) == sizeof(char);
+    };
+
+    static const int Slot_Min = 32;
+    static const int Slot_Mask = Slot_Min - 1;
+    static const int Slot_Class_Num = 25;
+
     template <class Key, class Value, class Compare = std::less<Key>>
     class Bptree{
     private:
         typedef std::pair<Key, int> key_offset;
+        //查询（find / exist / range_find）互斥：read_node 会调整缓存的 LRU 链，并行执行只读命令时多个线程会同时查同一棵树
+        //这把锁只保证并发查询安全，同一棵树上的查询仍是一个接一个做的，并不并行
+        //（缓存是写回的，脏节点只在这份缓存里，各线程另开文件句柄和缓存会读到旧页，所以没有拆成每线程一个读者）
+        //修改只在没有并发查询时发生，不加锁
+        std::mutex readLock;
 
     public:
        class basic_info;
@@ -39,9 +61,12 @@ int delete_num=0;
             // using basicinfo= typename sjtu::bptree<key_type,value_type,Compare>::basic_info;
             using data_type=bpt_node_type;
             using map_back = typename std::pair<bool, typename list::node *>;
+            using packed_tag = std::integral_constant<bool, packed_value<value_type>::value>;
 
             FILE *f1= nullptr;
             FILE *f_value= nullptr;
+            char *value_buf = nullptr;
+            int value_buf_cap = 0;
 
             class recycle_pool{//动态数组不好存进外存诶
             public://1--base
@@ -50,10 +75,19 @@ int delete_num=0;
                 int free_num1 = 0;
                 int free_num2 = 0;
                 const  int capacity = 25000;
+                //变长value：每个 size class 一条空闲槽链表（next 存在空闲槽里），以及文件尾
+                int free_head[Slot_Class_Num];
+                int value_tail = 0;
 
                 recycle_pool() {
                     memset(&(free_off1),0,sizeof(free_off1));
                     memset(&(free_off2),0,sizeof(free_off2));
+                    reset_slots();
+                }
+
+                void reset_slots() {
+                    for (int i = 0; i < Slot_Class_Num; ++i) free_head[i] = -1;
+                    value_tail = 0;
                 }
 
                 ~recycle_pool() = default;
@@ -298,6 +332,7 @@ int delete_num=0;
                 delete (cache);
                 delete (the_map);
                 delete recyclePool;
+                delete[] value_buf;
                 fclose(f1);
                 fclose(f_value);
                 // fseek()
@@ -318,6 +353,10 @@ int delete_num=0;
 
 
             int write_value(const value_type &value_) {
+                return write_value_(value_, packed_tag());
+            }
+
+            int write_value_(const value_type &value_, std::false_type) {
                // std::cout<<value_<<'\n';
                 int off_;
                 if (recyclePool->free_num2>0){
@@ -331,31 +370,119 @@ int delete_num=0;
                 return off_;
             }
 
-            //更新value
-            void write_value(const value_type &value_, int offset_) {
+            int write_value_(const value_type &value_, std::true_type) {
+                int len = value_.packedSize(), cls = slot_class(len);
+                int off_ = alloc_slot(cls);
+                put_slot(off_, value_, len);
+                return off_ | cls;
+            }
+
+            //更新value，返回新的offset（变长value放不下原槽时会换槽）
+            int write_value(const value_type &value_, int offset_) {
+                return write_value_(value_, offset_, packed_tag());
+            }
+
+            int write_value_(const value_type &value_, int offset_, std::false_type) {
                 fseek(f_value, offset_, SEEK_SET);
                 fwrite(&(value_), the_tree->value_size, 1, f_value);
+                return offset_;
+            }
+
+            int write_value_(const value_type &value_, int offset_, std::true_type) {
+                int len = value_.packedSize(), cls = offset_ & Slot_Mask;
+                if (len + (int)sizeof(int) > (Slot_Min << cls)) {
+                    free_slot(offset_);
+                    cls = slot_class(len);
+                    offset_ = alloc_slot(cls) | cls;
+                }
+                put_slot(offset_ & ~Slot_Mask, value_, len);
+                return offset_;
             }
 
             //by Sirius
             template<class T>
-            void write_info(const T& info_, int offset_) {
-                fseek(f_value, offset_, SEEK_SET);
+            void write_info(const T& info_, int offset_, size_t inner_off_) {
+                fseek(f_value, value_begin(offset_, packed_tag()) + inner_off_, SEEK_SET);
                 fwrite(&(info_), sizeof(T), 1, f_value);
             }
 
             //用引用传递而不是return应该可以提高效率
             void read_value(int off_, value_type &value_) {
+                read_value_(off_, value_, packed_tag());
+            }
+
+            void read_value_(int off_, value_type &value_, std::false_type) {
                 fseek(f_value, off_, SEEK_SET);
                 fread(&value_,the_tree->value_size,1,f_value);
                // fwrite(&(value_), the_tree->value_size, 1, f_value);
             }
 
+            void read_value_(int off_, value_type &value_, std::true_type) {
+                int len = 0;
+                fseek(f_value, off_ & ~Slot_Mask, SEEK_SET);
+                fread(&len, sizeof(int), 1, f_value);
+                reserve_buf(len);
+                fread(value_buf, len, 1, f_value);
+                value_.unpack(value_buf);
+            }
+
             void erase_value(int off_) {
                 //cache.erase()
+                erase_value_(off_, packed_tag());
+            }
+
+            void erase_value_(int off_, std::false_type) {
                 recyclePool->push_back_value(off_);
             }
 
+            void erase_value_(int off_, std::true_type) {
+                free_slot(off_);
+            }
+
+            int value_begin(int off_, std::false_type) {return off_;}
+            int value_begin(int off_, std::true_type) {return (off_ & ~Slot_Mask) + (int)sizeof(int);}
+
+            static int slot_class(int len) {
+                int cls = 0;
+                while ((Slot_Min << cls) < len + (int)sizeof(int)) ++cls;
+                return cls;
+            }
+
+            void reserve_buf(int len) {
+                if (len <= value_buf_cap) return;
+                delete[] value_buf;
+                value_buf_cap = std::max(len, value_buf_cap << 1);
+                value_buf = new char[value_buf_cap];
+            }
+
+            //空闲槽优先，否则从文件尾切一个
+            int alloc_slot(int cls) {
+                int off_ = recyclePool->free_head[cls];
+                if (off_ != -1) {
+                    fseek(f_value, off_ + sizeof(int), SEEK_SET);
+                    fread(&(recyclePool->free_head[cls]), sizeof(int), 1, f_value);
+                    return off_;
+                }
+                off_ = recyclePool->value_tail;
+                recyclePool->value_tail += Slot_Min << cls;
+                return off_;
+            }
+
+            void free_slot(int code_) {
+                int off_ = code_ & ~Slot_Mask, cls = code_ & Slot_Mask;
+                fseek(f_value, off_ + sizeof(int), SEEK_SET);
+                fwrite(&(recyclePool->free_head[cls]), sizeof(int), 1, f_value);
+                recyclePool->free_head[cls] = off_;
+            }
+
+            void put_slot(int off_, const value_type &value_, int len) {
+                reserve_buf(len + sizeof(int));
+                memcpy(value_buf, &len, sizeof(int));
+                value_.pack(value_buf + sizeof(int));
+                fseek(f_value, off_, SEEK_SET);
+                fwrite(value_buf, len + sizeof(int), 1, f_value);
+            }
+
 
             //还要写一个更新root的函数
             //offset在这个函数里面得到  //这个函数里面要更新缓存池 //这个应该是写进新节点
@@ -478,6 +605,7 @@ int delete_num=0;
                 the_map->clear();
                 recyclePool->free_num1 = 0;
                 recyclePool->free_num2 = 0;
+                recyclePool->reset_slots();
                 //delete the_tree->root;
                 fclose(f1);
                 fclose(f_value);
@@ -1045,7 +1173,8 @@ int delete_num=0;
             node_index p = search_node(key);
             if (p.first != nullptr)
             {
-                the_manager->write_value(value,p.first->little_node[p.second].second);
+                int &off_ = p.first->little_node[p.second].second;
+                off_ = the_manager->write_value(value, off_);
                 return true;
             }
             return false;
@@ -1055,12 +1184,13 @@ int delete_num=0;
         bool modify_info(const Key &key, const T& info, size_t offset) {
             node_index p = search_node(key);
             if (p.first == nullptr) return false;
-            the_manager->write_info(info, p.first->little_node[p.second].second+offset);
+            the_manager->write_info(info, p.first->little_node[p.second].second, offset);
             return true;
         }
 
         std::pair<Value, bool> find(const Key &key)
         {
+            std::lock_guard<std::mutex> guard(readLock);
             node_index parent = search_node(key);
             Value val;
             if (parent.first != nullptr){
@@ -1073,6 +1203,7 @@ int delete_num=0;
         }
 
         bool exist(const Key &key) {
+            std::lock_guard<std::mutex> guard(readLock);
             node_index parent = search_node(key);
             return parent.first != nullptr;
         }
@@ -1110,10 +1241,18 @@ int delete_num=0;
         }
 
         void range_find(const Key &key_low, const Key& key_high, value_type* ret, int& retCnt){
+            retCnt = 0;
+            range_find(key_low, key_high, [&]() {return ret + retCnt++;});
+        }
+
+        //结果个数事先不知道时用：每找到一个就调 next() 要一个存放位置（由调用者负责扩容）
+        template<class Next>
+        void range_find(const Key &key_low, const Key& key_high, Next next){
           //  Key low=key_low,high=key_high;
 
          // std::cout<<key_low<<'\n';
 
+            std::lock_guard<std::mutex> guard(readLock);
             node_index now_node_index=search_node(key_low);
             Node* now_node=now_node_index.first;  int index=now_node_index.second;
             if (now_node== nullptr){
@@ -1123,13 +1262,12 @@ int delete_num=0;
             }
 
             //std::cout<<index<<'\n';
-            retCnt = 0;
+            if (now_node->siz == 0) return; //空树：root 里剩下的是删掉或 clear 前的旧键
             while (now_node->little_node[index].first<=key_high)
             {
                 if (now_node->little_node[index].first>=key_low)
                 {
-                    the_manager->read_value(now_node->little_node[index].second, *(ret+retCnt));
-                    retCnt++;
+                    the_manager->read_value(now_node->little_node[index].second, *next());
                 }
                 if (index<now_node->siz)index++;
                 else
@@ -0,0 +1,499 @@
+//
+// Created by SiriusNEO.
+//
+
+#ifndef BTREE_OLC_BPT_HPP
+#define BTREE_OLC_BPT_HPP
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+    /* 多线程共用的缓冲池：页号 -> 帧，pin 住的帧不会被换出
+     * 页表是两级目录，命中时不加锁：读出帧号，pin 上之后再核对帧里还是不是这一页（可能刚被换走），不是就放开重来
+     * 不命中时在 miss_lock 下按时钟算法找 pin 为 0 的帧，CAS 成 -Evicting 独占它，写回脏页、读入新页、登记页表后再放开
+     * 读写文件用 pread / pwrite，没有共享的文件指针；同时 pin 住的帧必须少于帧数
+     */
+    class PagePool {
+    public:
+        static const int Page_Size = 4096;
+
+    private:
+        static const int Chunk_Bits = 12, Chunk_Size = 1 << Chunk_Bits, Dir_Size = 1 << 14;
+        static const int Evicting = 1 << 30;
+        struct Frame {
+            std::atomic<int> pin; //< 0：正在换页
+            std::atomic<int> page_id; //-1：空帧
+            std::atomic<bool> dirty, ref; //ref：时钟算法的访问位
+        };
+        int fd;
+        int frame_num, hand;
+        char *pages;
+        Frame *frames;
+        std::atomic<std::atomic<int>*> dir[Dir_Size]; //页号高位 -> 一块 Chunk_Size 个帧号，-1 为不在内存
+        std::atomic<int> page_num;
+        std::mutex miss_lock;
+
+        std::atomic<int> *slot(int page_id_, bool create_) {
+            std::atomic<int> *chunk = dir[page_id_ >> Chunk_Bits].load(std::memory_order_acquire);
+            if (!chunk) {
+                if (!create_) return nullptr;
+                chunk = new std::atomic<int>[Chunk_Size];
+                for (int i = 0; i < Chunk_Size; ++i) chunk[i].store(-1, std::memory_order_relaxed);
+                dir[page_id_ >> Chunk_Bits].store(chunk, std::memory_order_release);
+            }
+            return chunk + (page_id_ & (Chunk_Size - 1));
+        }
+
+        void write_back(int frame_) {
+            pwrite(fd, pages + (long long)frame_ * Page_Size, Page_Size, (off_t)frames[frame_].page_id.load(std::memory_order_relaxed) * Page_Size);
+            frames[frame_].dirty.store(false, std::memory_order_relaxed);
+        }
+
+        int victim() { //在 miss_lock 下调用，返回的帧已被独占
+            while (true) {
+                int f = hand;
+                hand = (hand + 1) % frame_num;
+                if (frames[f].pin.load(std::memory_order_relaxed) != 0) continue;
+                if (frames[f].ref.exchange(false, std::memory_order_relaxed)) continue;
+                int zero = 0;
+                if (frames[f].pin.compare_exchange_strong(zero, -Evicting, std::memory_order_acq_rel)) return f;
+            }
+        }
+
+        //把 page_id_ 换进一个帧并 pin 上；fresh_ 为新页，不读文件直接清零。已经有别的线程换进来了返回 -1
+        int load(int page_id_, bool fresh_) {
+            std::lock_guard<std::mutex> guard(miss_lock);
+            std::atomic<int> *s = slot(page_id_, true);
+            if (s->load(std::memory_order_relaxed) != -1) return -1;
+            int f = victim();
+            int old = frames[f].page_id.load(std::memory_order_relaxed);
+            if (old != -1) {
+                if (frames[f].dirty.load(std::memory_order_relaxed)) write_back(f);
+                slot(old, false)->store(-1, std::memory_order_relaxed);
+            }
+            char *p = pages + (long long)f * Page_Size;
+            ssize_t got = fresh_ ? 0 : pread(fd, p, Page_Size, (off_t)page_id_ * Page_Size);
+            if (got < Page_Size) memset(p + std::max<ssize_t>(got, 0), 0, Page_Size - std::max<ssize_t>(got, 0));
+            frames[f].page_id.store(page_id_, std::memory_order_relaxed);
+            frames[f].dirty.store(fresh_, std::memory_order_relaxed);
+            frames[f].ref.store(true, std::memory_order_relaxed);
+            s->store(f, std::memory_order_release);
+            frames[f].pin.fetch_add(Evicting + 1, std::memory_order_acq_rel); //换页期间别人加上又减掉的不受影响
+            return f;
+        }
+
+    public:
+        PagePool(const char *file_name_, int frame_num_):frame_num(frame_num_), hand(0) {
+            fd = open(file_name_, O_RDWR | O_CREAT, 0644);
+            page_num.store(lseek(fd, 0, SEEK_END) / Page_Size, std::memory_order_relaxed);
+            pages = new char[(long long)frame_num * Page_Size];
+            frames = new Frame[frame_num];
+            for (int i = 0; i < frame_num; ++i) {
+                frames[i].pin.store(0), frames[i].page_id.store(-1);
+                frames[i].dirty.store(false), frames[i].ref.store(false);
+            }
+            for (int i = 0; i < Dir_Size; ++i) dir[i].store(nullptr);
+        }
+
+        ~PagePool() {
+            flush();
+            close(fd);
+            for (int i = 0; i < Dir_Size; ++i) delete[] dir[i].load();
+            delete[] frames;
+            delete[] pages;
+        }
+
+        int page_count() const {return page_num.load(std::memory_order_relaxed);}
+
+        int pin(int page_id_) { //返回帧号，用完 unpin
+            while (true) {
+                std::atomic<int> *s = slot(page_id_, false);
+                int f = s ? s->load(std::memory_order_acquire) : -1;
+                if (f == -1) {
+                    if ((f = load(page_id_, false)) != -1) return f;
+                    continue;
+                }
+                if (frames[f].pin.fetch_add(1, std::memory_order_acq_rel) >= 0
+                    && frames[f].page_id.load(std::memory_order_relaxed) == page_id_) {
+                    frames[f].ref.store(true, std::memory_order_relaxed);
+                    return f;
+                }
+                frames[f].pin.fetch_sub(1, std::memory_order_release);
+                std::this_thread::yield();
+            }
+        }
+        int new_page(int &frame_) { //分配一个清零的新页并 pin 上，返回页号
+            int page_id_ = page_num.fetch_add(1, std::memory_order_relaxed);
+            frame_ = load(page_id_, true);
+            return page_id_;
+        }
+        void unpin(int frame_) {frames[frame_].pin.fetch_sub(1, std::memory_order_release);}
+        void mark_dirty(int frame_) {frames[frame_].dirty.store(true, std::memory_order_relaxed);}
+        char *page(int frame_) {return pages + (long long)frame_ * Page_Size;}
+
+        //以下两个只在没有并发访问时调用
+        void flush() {
+            for (int i = 0; i < frame_num; ++i)
+                if (frames[i].page_id.load() != -1 && frames[i].dirty.load()) write_back(i);
+        }
+        void reset() { //丢掉所有页，文件清空；调用前要放开所有 pin
+            for (int i = 0; i < frame_num; ++i) frames[i].pin.store(0), frames[i].page_id.store(-1), frames[i].dirty.store(false);
+            for (int i = 0; i < Dir_Size; ++i)
+                if (std::atomic<int> *chunk = dir[i].load())
+                    for (int j = 0; j < Chunk_Size; ++j) chunk[j].store(-1);
+            ftruncate(fd, 0);
+            page_num.store(0);
+        }
+    };
+
+    /* 多线程可以同时 find / range_find / insert / modify 的 B+ 树：乐观锁耦合（Optimistic Lock Coupling）
+     * 每个节点一个版本字（第 1 位是写锁，其余是计数）：读不加锁，读完核对版本没变，变了就从根重来；写把读到的版本 CAS 成加锁状态，放锁时计数加一
+     * 往下走时先读到孩子的版本再核对父亲，保证孩子确实还管着这个键；插入时沿路把满的内部节点先分裂（只锁它和父亲），叶子分裂时父亲一定有空位
+     * 节点就是缓冲池里的一页，父子、兄弟之间存页号；访问一页期间 pin 住它，换出不会动到正在读的帧
+     * 键、值都是定长、可以按字节拷贝的类型，值直接放在叶子里；不提供删除。第 0 页存根页号和记录数
+     */
+    template <class Key, class Value>
+    class OlcBptree {
+    private:
+        typedef unsigned long long version_type;
+        struct Node {
+            std::atomic<version_type> version;
+            int is_leaf, count;
+        };
+        static const int Inner_Cap = (PagePool::Page_Size - sizeof(Node) - sizeof(int)) / (sizeof(Key) + sizeof(int)) - 1;
+        static const int Leaf_Cap = (PagePool::Page_Size - sizeof(Node) - sizeof(int)) / (sizeof(Key) + sizeof(Value)) - 1;
+        struct Inner : Node {
+            Key keys[Inner_Cap]; //children[i] 里的键都 <= keys[i]，且 > keys[i-1]
+            int children[Inner_Cap + 1];
+        };
+        struct Leaf : Node {
+            int next; //右兄弟的页号，-1 为最右
+            Key keys[Leaf_Cap];
+            Value vals[Leaf_Cap];
+        };
+        struct Meta {
+            int root, values_num;
+        };
+        static_assert(sizeof(Inner) <= PagePool::Page_Size && sizeof(Leaf) <= PagePool::Page_Size, "node does not fit in a page");
+        static_assert(Inner_Cap >= 4 && Leaf_Cap >= 4, "key or value too large for a page");
+
+        class PinSet { //一次尝试 pin 住的帧，退出时统一放开
+        private:
+            PagePool &pool;
+            int frames[8], num;
+        public:
+            explicit PinSet(PagePool &pool_):pool(pool_), num(0) {}
+            ~PinSet() {for (int i = 0; i < num; ++i) pool.unpin(frames[i]);}
+            void add(int frame_) {frames[num++] = frame_;}
+            void drop(int frame_) {
+                for (int i = 0; i < num; ++i)
+                    if (frames[i] == frame_) {pool.unpin(frame_), frames[i] = frames[--num]; return;}
+            }
+        };
+
+        PagePool pool;
+        int meta_frame; //第 0 页一直 pin 着
+        std::atomic<int> root;
+        std::atomic<int> values_num;
+
+        Node *node_at(int frame_) {return (Node *)pool.page(frame_);}
+
+        static bool read_lock(Node *node_, version_type &version_) { //正被写返回 false
+            version_ = node_->version.load(std::memory_order_acquire);
+            if (version_ & 2) {std::this_thread::yield(); return false;}
+            return true;
+        }
+        static bool validate(Node *node_, version_type version_) { //读到的内容在 version_ 之后没被改过
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return node_->version.load(std::memory_order_relaxed) == version_;
+        }
+        static bool upgrade(Node *node_, version_type version_) {
+            return node_->version.compare_exchange_strong(version_, version_ + 2, std::memory_order_acquire);
+        }
+        static void write_unlock(Node *node_) {node_->version.fetch_add(2, std::memory_order_release);}
+
+        //乐观读时 count 可能是写到一半的值，先夹到合法范围，结果由 validate 兜底
+        static int lower_bound(const Key *keys_, int n_, int cap_, const Key &key_) { //第一个 >= key_ 的位置
+            int l = 0, r = std::min(std::max(n_, 0), cap_);
+            while (l < r) {
+                int mid = (l + r) >> 1;
+                if (keys_[mid] < key_) l = mid + 1;
+                else r = mid;
+            }
+            return l;
+        }
+        static int upper_bound(const Key *keys_, int n_, int cap_, const Key &key_) { //第一个 > key_ 的位置
+            int l = 0, r = std::min(std::max(n_, 0), cap_);
+            while (l < r) {
+                int mid = (l + r) >> 1;
+                if (key_ < keys_[mid]) r = mid;
+                else l = mid + 1;
+            }
+            return l;
+        }
+
+        void init_fresh() { //空文件：建第 0 页和一个空叶子做根
+            pool.new_page(meta_frame);
+            int leaf_frame, leaf_page = pool.new_page(leaf_frame);
+            Leaf *leaf = (Leaf *)node_at(leaf_frame);
+            leaf->is_leaf = 1, leaf->count = 0, leaf->next = -1;
+            pool.unpin(leaf_frame);
+            root.store(leaf_page), values_num.store(0);
+        }
+
+        //读路径：从根走到 key_ 所在的叶子，pin 住放进 pins_；碰上写冲突返回 false，调用者从头重来
+        bool find_leaf(const Key &key_, PinSet &pins_, int &frame_, Leaf *&leaf_, version_type &version_) {
+            int page_id_ = root.load(std::memory_order_acquire);
+            frame_ = pool.pin(page_id_), pins_.add(frame_);
+            Node *node = node_at(frame_);
+            if (!read_lock(node, version_) || page_id_ != root.load(std::memory_order_acquire)) return false;
+            while (!node->is_leaf) {
+                Inner *inner = (Inner *)node;
+                int child = inner->children[lower_bound(inner->keys, inner->count, Inner_Cap, key_)];
+                if (!validate(node, version_)) return false;
+                int child_frame = pool.pin(child);
+                pins_.add(child_frame);
+                Node *child_node = node_at(child_frame);
+                version_type child_version;
+                if (!read_lock(child_node, child_version) || !validate(node, version_)) return false;
+                pins_.drop(frame_);
+                frame_ = child_frame, node = child_node, version_ = child_version;
+            }
+            leaf_ = (Leaf *)node;
+            return true;
+        }
+
+        //把满的 node_ 分成两半，分隔键插进父亲（没有父亲就是根，长出新根）；拿不到锁就直接返回，调用者总会从头重来
+        void split(Inner *parent_, int parent_frame_, version_type parent_version_,
+                   Node *node_, int frame_, version_type version_, int page_id_, PinSet &pins_) {
+            if (parent_ && !upgrade(parent_, parent_version_)) return;
+            if (!upgrade(node_, version_)) {
+                if (parent_) write_unlock(parent_);
+                return;
+            }
+            if (!parent_ && page_id_ != root.load(std::memory_order_relaxed)) { //读的时候还是根，现在已经不是了
+                write_unlock(node_);
+                return;
+            }
+            int right_frame, right_page = pool.new_page(right_frame);
+            pins_.add(right_frame);
+            Key sep;
+            if (node_->is_leaf) {
+                Leaf *left = (Leaf *)node_, *right = (Leaf *)node_at(right_frame);
+                int n = left->count, mid = n / 2;
+                right->is_leaf = 1, right->count = n - mid, right->next = left->next;
+                memcpy((void *)right->keys, left->keys + mid, (n - mid) * sizeof(Key));
+                memcpy((void *)right->vals, left->vals + mid, (n - mid) * sizeof(Value));
+                left->count = mid, left->next = right_page;
+                sep = left->keys[mid - 1];
+            }
+            else {
+                Inner *left = (Inner *)node_, *right = (Inner *)node_at(right_frame);
+                int n = left->count, mid = n / 2;
+                right->is_leaf = 0, right->count = n - mid - 1;
+                memcpy((void *)right->keys, left->keys + mid + 1, (n - mid - 1) * sizeof(Key));
+                memcpy(right->children, left->children + mid + 1, (n - mid) * sizeof(int));
+                left->count = mid;
+                sep = left->keys[mid];
+            }
+            pool.mark_dirty(frame_);
+            if (parent_) {
+                int n = parent_->count, pos = lower_bound(parent_->keys, n, Inner_Cap, sep);
+                memmove((void *)(parent_->keys + pos + 1), parent_->keys + pos, (n - pos) * sizeof(Key));
+                memmove(parent_->children + pos + 2, parent_->children + pos + 1, (n - pos) * sizeof(int));
+                parent_->keys[pos] = sep, parent_->children[pos + 1] = right_page, ++parent_->count;
+                pool.mark_dirty(parent_frame_);
+                write_unlock(parent_);
+            }
+            else {
+                int root_frame, root_page = pool.new_page(root_frame);
+                pins_.add(root_frame);
+                Inner *new_root = (Inner *)node_at(root_frame);
+                new_root->is_leaf = 0, new_root->count = 1;
+                new_root->keys[0] = sep, new_root->children[0] = page_id_, new_root->children[1] = right_page;
+                root.store(root_page, std::memory_order_release);
+            }
+            write_unlock(node_);
+        }
+
+        int try_insert(const Key &key_, const Value &value_) { //0：冲突要重来；1：插入了；2：键已存在
+            PinSet pins(pool);
+            int page_id_ = root.load(std::memory_order_acquire), frame = pool.pin(page_id_);
+            pins.add(frame);
+            Node *node = node_at(frame);
+            version_type version;
+            if (!read_lock(node, version) || page_id_ != root.load(std::memory_order_acquire)) return 0;
+            Inner *parent = nullptr;
+            int parent_frame = -1;
+            version_type parent_version = 0;
+            while (!node->is_leaf) {
+                Inner *inner = (Inner *)node;
+                if (inner->count == Inner_Cap) { //满了先分裂，分完从头再走
+                    split(parent, parent_frame, parent_version, node, frame, version, page_id_, pins);
+                    return 0;
+                }
+                if (parent) {
+                    if (!validate(parent, parent_version)) return 0;
+                    pins.drop(parent_frame);
+                }
+                parent = inner, parent_frame = frame, parent_version = version;
+                page_id_ = inner->children[lower_bound(inner->keys, inner->count, Inner_Cap, key_)];
+                if (!validate(node, version)) return 0;
+                frame = pool.pin(page_id_), pins.add(frame);
+                node = node_at(frame);
+                if (!read_lock(node, version)) return 0;
+            }
+            Leaf *leaf = (Leaf *)node;
+            if (leaf->count == Leaf_Cap) {
+                split(parent, parent_frame, parent_version, node, frame, version, page_id_, pins);
+                return 0;
+            }
+            if (!upgrade(node, version)) return 0;
+            if (parent && !validate(parent, parent_version)) {
+                write_unlock(node);
+                return 0;
+            }
+            int n = leaf->count, pos = lower_bound(leaf->keys, n, Leaf_Cap, key_);
+            if (pos < n && !(key_ < leaf->keys[pos])) {
+                write_unlock(node);
+                return 2;
+            }
+            memmove((void *)(leaf->keys + pos + 1), leaf->keys + pos, (n - pos) * sizeof(Key));
+            memmove((void *)(leaf->vals + pos + 1), leaf->vals + pos, (n - pos) * sizeof(Value));
+            leaf->keys[pos] = key_, leaf->vals[pos] = value_, ++leaf->count;
+            pool.mark_dirty(frame);
+            write_unlock(node);
+            values_num.fetch_add(1, std::memory_order_relaxed);
+            return 1;
+        }
+
+    public:
+        explicit OlcBptree(const char *file_name_, int frame_num_ = 4096):pool(file_name_, frame_num_) {
+            if (!pool.page_count()) {init_fresh(); return;}
+            meta_frame = pool.pin(0);
+            Meta meta;
+            memcpy(&meta, pool.page(meta_frame), sizeof(Meta));
+            root.store(meta.root), values_num.store(meta.values_num);
+        }
+
+        ~OlcBptree() {
+            Meta meta = (Meta){root.load(), values_num.load()};
+            memcpy(pool.page(meta_frame), &meta, sizeof(Meta));
+            pool.mark_dirty(meta_frame);
+            pool.unpin(meta_frame);
+        }
+
+        int size() {return values_num.load(std::memory_order_relaxed);}
+
+        void clear() { //不能和其它操作并发
+            pool.unpin(meta_frame);
+            pool.reset();
+            init_fresh();
+        }
+
+        bool insert(const Key &key_, const Value &value_) { //键已存在返回 false
+            int ret;
+            while (!(ret = try_insert(key_, value_)));
+            return ret == 1;
+        }
+
+        std::pair<Value, bool> find(const Key &key_) {
+            while (true) {
+                PinSet pins(pool);
+                int frame;
+                Leaf *leaf;
+                version_type version;
+                if (!find_leaf(key_, pins, frame, leaf, version)) continue;
+                int n = leaf->count, pos = lower_bound(leaf->keys, n, Leaf_Cap, key_);
+                bool found = pos < std::min(std::max(n, 0), Leaf_Cap) && !(key_ < leaf->keys[pos]);
+                Value val = Value();
+                if (found) memcpy((void *)&val, leaf->vals + pos, sizeof(Value));
+                if (validate(leaf, version)) return std::make_pair(val, found);
+            }
+        }
+
+        //把 key_ 对应值从 offset_ 字节起改成 info_，没有这个键返回 false
+        template<class T>
+        bool modify_info(const Key &key_, const T &info_, size_t offset_) {
+            while (true) {
+                PinSet pins(pool);
+                int frame;
+                Leaf *leaf;
+                version_type version;
+                if (!find_leaf(key_, pins, frame, leaf, version) || !upgrade(leaf, version)) continue;
+                int n = leaf->count, pos = lower_bound(leaf->keys, n, Leaf_Cap, key_);
+                bool found = pos < n && !(key_ < leaf->keys[pos]);
+                if (found) memcpy((char *)(leaf->vals + pos) + offset_, &info_, sizeof(T)), pool.mark_dirty(frame);
+                write_unlock(leaf);
+                return found;
+            }
+        }
+        bool modify(const Key &key_, const Value &value_) {return modify_info(key_, value_, 0);}
+        //keys_ 升序：都从 offset_ 字节起改成 info_，落在同一叶子的键只下降、加锁一次，返回改到的个数
+        template<class T>
+        int batch_modify_info(const Key *keys_, int n_, const T &info_, size_t offset_) {
+            int done = 0;
+            for (int i = 0; i < n_; ) {
+                PinSet pins(pool);
+                int frame;
+                Leaf *leaf;
+                version_type version;
+                if (!find_leaf(keys_[i], pins, frame, leaf, version) || !upgrade(leaf, version)) continue;
+                int n = leaf->count, found = 0;
+                do {
+                    int pos = lower_bound(leaf->keys, n, Leaf_Cap, keys_[i]);
+                    if (pos < n && !(keys_[i] < leaf->keys[pos])) memcpy((char *)(leaf->vals + pos) + offset_, &info_, sizeof(T)), ++found;
+                    ++i;
+                } while (i < n_ && n && !(leaf->keys[n - 1] < keys_[i])); //比叶子最大键还大的去后面的叶子
+                if (found) pool.mark_dirty(frame), done += found;
+                write_unlock(leaf);
+            }
+            return done;
+        }
+
+        //[key_low, key_high] 里的值按键递增交出去，每个调一次 next() 要存放位置
+        //每个叶子先拷出来、核对版本后才交，冲突时从最后交出的键之后重新找，不会重复也不会漏
+        template<class Next>
+        void range_find(const Key &key_low, const Key &key_high, Next next) {
+            Key from = key_low, keys[Leaf_Cap];
+            Value vals[Leaf_Cap];
+            bool after = false; //from 已经交出去了，从严格大于它的开始
+            while (true) {
+                PinSet pins(pool);
+                int frame;
+                Leaf *leaf;
+                version_type version;
+                if (!find_leaf(from, pins, frame, leaf, version)) continue;
+                while (true) {
+                    int n = std::min(std::max((int)leaf->count, 0), Leaf_Cap), cnt = 0;
+                    int pos = after ? upper_bound(leaf->keys, n, Leaf_Cap, from) : lower_bound(leaf->keys, n, Leaf_Cap, from);
+                    bool done = false;
+                    for (; pos < n; ++pos, ++cnt) {
+                        if (key_high < leaf->keys[pos]) {done = true; break;}
+                        memcpy((void *)(keys + cnt), leaf->keys + pos, sizeof(Key));
+                        memcpy((void *)(vals + cnt), leaf->vals + pos, sizeof(Value));
+                    }
+                    int next_page = leaf->next;
+                    if (!validate(leaf, version)) break;
+                    for (int i = 0; i < cnt; ++i) *next() = vals[i];
+                    if (cnt) from = keys[cnt - 1], after = true;
+                    if (done || next_page == -1) return;
+                    int next_frame = pool.pin(next_page);
+                    pins.add(next_frame);
+                    Leaf *next_leaf = (Leaf *)node_at(next_frame);
+                    version_type next_version;
+                    if (!read_lock(next_leaf, next_version)) break;
+                    pins.drop(frame);
+                    frame = next_frame, leaf = next_leaf, version = next_version;
+                }
+            }
+        }
+    };
+
+#endif //BTREE_OLC_BPT_HPP
@@ -0,0 +1,113 @@
+//
+// Created by SiriusNEO.
+//
+
+#ifndef BTREE_SEAT_MATRIX_HPP
+#define BTREE_SEAT_MATRIX_HPP
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include "bpt.hpp"
+
+    //按车次连续存放的座位矩阵：每个车次一块 days * seg_num 的 int，第 d 天第 s 段在 offset + (d*seg_num+s)*4
+    //index 只记每块的位置和形状，查某天的座位就是一次 offset 计算加一次连续读
+    //写时复制：分配只预留空间，某天第一次被写之前那一行不落盘，读它时直接返回 init_seat
+    template <class Key>
+    class SeatMatrix{
+    public:
+        static const int Day_Word = 6; //touched 能记 6*64 天，售卖期更长的车次 allocate 会拒绝
+
+        class block_info{
+        public:
+            int offset=-1;
+            int first_day=0; //售卖首日（天编号）
+            int days=0;
+            int seg_num=0;
+            int init_seat=0;
+            unsigned long long touched[Day_Word]={0}; //哪些天已经落盘
+
+            bool is_touched(int day_) const {
+                day_ -= first_day;
+                return touched[day_ >> 6] >> (day_ & 63) & 1;
+            }
+        };
+
+    private:
+        Bptree<Key, block_info> index;
+        FILE *f_seat= nullptr;
+        char file_name[25]={0};
+        int tail=0; //文件头存已预留到的位置
+        std::mutex rowLock; //read_row 的 fseek + fread 要成对，并行查询时互斥
+
+        long long row_off(const block_info &info_, int day_) const {
+            return info_.offset + (long long)(day_ - info_.first_day) * info_.seg_num * sizeof(int);
+        }
+
+        void init_file(){
+            f_seat = fopen(file_name, "wb+");
+            tail = sizeof(int);
+            fwrite(&tail, sizeof(int), 1, f_seat);
+        }
+
+    public:
+        SeatMatrix(const char *file_name_, const char *index_name1_, const char *index_name2_):index(index_name1_, index_name2_){
+            strcpy(file_name, file_name_);
+            f_seat = fopen(file_name, "rb+");
+            if (!f_seat) init_file();
+            else fread(&tail, sizeof(int), 1, f_seat);
+        }
+
+        ~SeatMatrix(){
+            fseek(f_seat, 0, SEEK_SET);
+            fwrite(&tail, sizeof(int), 1, f_seat);
+            fclose(f_seat);
+        }
+
+        //一次性给整个售卖期预留空间，不写任何一行；售卖期超过 touched 能记的天数返回 false
+        //预留后立刻把新的文件尾写回文件头，不等析构
+        bool allocate(const Key &key_, int first_day_, int days_, int seg_num_, int init_seat_){
+            if (days_ <= 0 || days_ > Day_Word * 64) return false;
+            block_info info;
+            info.offset = tail;
+            info.first_day = first_day_, info.days = days_, info.seg_num = seg_num_, info.init_seat = init_seat_;
+            tail += days_ * seg_num_ * sizeof(int);
+            index.insert(key_, info);
+            fseek(f_seat, 0, SEEK_SET);
+            fwrite(&tail, sizeof(int), 1, f_seat);
+            fflush(f_seat);
+            return true;
+        }
+
+        std::pair<block_info, bool> find(const Key &key_){
+            return index.find(key_);
+        }
+
+        void read_row(const block_info &info_, int day_, int *row_){
+            if (!info_.is_touched(day_)) {
+                for (int i = 0; i < info_.seg_num; ++i) row_[i] = info_.init_seat;
+                return;
+            }
+            std::lock_guard<std::mutex> guard(rowLock);
+            fseek(f_seat, row_off(info_, day_), SEEK_SET);
+            fread(row_, sizeof(int), info_.seg_num, f_seat);
+        }
+
+        void write_row(const Key &key_, block_info &info_, int day_, const int *row_){
+            fseek(f_seat, row_off(info_, day_), SEEK_SET);
+            fwrite(row_, sizeof(int), info_.seg_num, f_seat);
+            if (!info_.is_touched(day_)) {
+                int d = day_ - info_.first_day;
+                info_.touched[d >> 6] |= 1ull << (d & 63);
+                index.modify(key_, info_);
+            }
+        }
+
+        void clear(){
+            index.clear();
+            fclose(f_seat);
+            init_file();
+        }
+    };
+
+#endif //BTREE_SEAT_MATRIX_HPP
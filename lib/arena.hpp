@@ -0,0 +1,107 @@
+//
+// Created by SiriusNEO.
+//
+
+#ifndef TICKETSYSTEM_2021_MAIN_ARENA_HPP
+#define TICKETSYSTEM_2021_MAIN_ARENA_HPP
+
+#include <cstring>
+#include <cstddef>
+#include <type_traits>
+
+namespace Sirius {
+    /* 每条命令的临时内存：指针往后推着分配，命令开始时 reset 一次性全部收回
+     * 当前块不够就再开一块（已分配的指针不动）；reset 时若用了不止一块，就按这次的总量换成一整块，之后同样的负载不再开块
+     * 只放可以按字节拷贝的类型，内容不初始化
+     */
+    class Arena {
+    private:
+        struct Block {
+            char* buf;
+            size_t cap;
+            Block* prev;
+        };
+        static constexpr size_t Align = 16, Block_Min = 1 << 16;
+        Block* cur;
+        size_t top, used, highWater; //top：当前块里已用到哪；used：本轮总量
+
+        static size_t alignUp(size_t x) {return (x + Align - 1) & ~(Align - 1);}
+        void newBlock(size_t cap) {
+            cur = new Block{new char[cap], cap, cur};
+            top = 0;
+        }
+        void freeBlocks() {
+            while (cur) {
+                Block* prev = cur->prev;
+                delete[] cur->buf, delete cur;
+                cur = prev;
+            }
+        }
+
+    public:
+        Arena():cur(nullptr), top(0), used(0), highWater(0) {newBlock(Block_Min);}
+        ~Arena() {freeBlocks();}
+        Arena(const Arena&) = delete;
+        Arena& operator = (const Arena&) = delete;
+
+        template<class T>
+        T* alloc(int n) {
+            static_assert(std::is_trivially_copyable<T>::value, "arena only holds trivially copyable types");
+            size_t bytes = alignUp(sizeof(T) * (n > 0 ? n : 1));
+            if (top + bytes > cur->cap) newBlock(bytes > cur->cap * 2 ? bytes : cur->cap * 2);
+            T* ret = (T*)(cur->buf + top);
+            top += bytes, used += bytes;
+            if (used > highWater) highWater = used;
+            return ret;
+        }
+        //把 p（n 个）扩到 newN 个：p 是最后一次分配且块里放得下就原地扩，否则搬到新位置
+        template<class T>
+        T* grow(T* p, int n, int newN) {
+            size_t oldBytes = alignUp(sizeof(T) * (n > 0 ? n : 1)), newBytes = alignUp(sizeof(T) * newN);
+            if ((char*)p + oldBytes == cur->buf + top && top - oldBytes + newBytes <= cur->cap) {
+                top += newBytes - oldBytes, used += newBytes - oldBytes;
+                if (used > highWater) highWater = used;
+                return p;
+            }
+            T* ret = alloc<T>(newN);
+            memcpy(ret, p, sizeof(T) * n);
+            return ret;
+        }
+
+        void reset() {
+            if (cur->prev) { //这轮开了多块：合成一块
+                size_t cap = cur->cap;
+                for (Block* b = cur->prev; b; b = b->prev) cap += b->cap;
+                freeBlocks();
+                newBlock(cap);
+            }
+            top = used = 0;
+        }
+        size_t highWaterMark() const {return highWater;} //单条命令用到的最大字节数
+    };
+
+    /* 在 Arena 上自动增长的数组，容量翻倍，随 Arena::reset 一起作废 */
+    template<class T>
+    class ArenaArray {
+    private:
+        Arena* arena;
+        T* buf;
+        int siz, cap;
+
+    public:
+        explicit ArenaArray(Arena& _arena, int _cap = 16):arena(&_arena), buf(_arena.alloc<T>(_cap)), siz(0), cap(_cap > 0 ? _cap : 1) {}
+        T* emplace() { //在末尾留一个位置并返回，内容由调用者写
+            if (siz == cap) buf = arena->grow(buf, cap, cap * 2), cap *= 2;
+            return buf + siz++;
+        }
+        void push_back(const T& x) {*emplace() = x;}
+        T& operator [] (int pos) {return buf[pos];}
+        const T& operator [] (int pos) const {return buf[pos];}
+        T* begin() {return buf;}
+        T* end() {return buf + siz;}
+        int size() const {return siz;}
+        bool empty() const {return !siz;}
+    };
+}
+
+#endif //TICKETSYSTEM_2021_MAIN_ARENA_HPP
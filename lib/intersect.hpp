@@ -0,0 +1,88 @@
+//
+// Created by SiriusNEO.
+//
+
+#ifndef TICKETSYSTEM_2021_MAIN_INTERSECT_HPP
+#define TICKETSYSTEM_2021_MAIN_INTERSECT_HPP
+
+#include "mytools.hpp"
+#include "seatops.hpp"
+
+namespace Sirius {
+    /* 两个严格递增的 hashCode 数组求交，输出相等元素在两边的下标对（按下标递增）
+     * 长度悬殊时对短的每个元素在长的里倍增查找（galloping），O(n log(m/n))
+     * 长度相近时按 4x4 块比较（AVX2，4 次循环移位的 cmpeq 覆盖所有配对），否则标量双指针
+     */
+    constexpr int Gallop_Ratio = 32;
+
+    //第一个 >= key 的位置，从 lo 开始倍增
+    inline int gallop(const hashCode* a, int lo, int n, hashCode key) {
+        int step = 1, hi = lo;
+        while (hi < n && a[hi] < key) lo = hi + 1, hi += step, step <<= 1;
+        if (hi > n) hi = n;
+        while (lo < hi) {
+            int mid = (lo + hi) >> 1;
+            if (a[mid] < key) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    inline int intersectGallop(const hashCode* a, int n, const hashCode* b, int m, int* ia, int* ib) {
+        int cnt = 0;
+        if (n <= m) {
+            for (int i = 0, j = 0; i < n && j < m; ++i) {
+                j = gallop(b, j, m, a[i]);
+                if (j < m && b[j] == a[i]) ia[cnt] = i, ib[cnt++] = j++;
+            }
+        }
+        else {
+            for (int i = 0, j = 0; i < n && j < m; ++j) {
+                i = gallop(a, i, n, b[j]);
+                if (i < n && a[i] == b[j]) ia[cnt] = i++, ib[cnt++] = j;
+            }
+        }
+        return cnt;
+    }
+
+    inline int intersectScalar(const hashCode* a, int n, const hashCode* b, int m, int* ia, int* ib, int i = 0, int j = 0, int cnt = 0) {
+        while (i < n && j < m) {
+            if (a[i] < b[j]) ++i;
+            else if (a[i] > b[j]) ++j;
+            else ia[cnt] = i++, ib[cnt++] = j++;
+        }
+        return cnt;
+    }
+
+#ifdef SIRIUS_X86_SIMD
+    __attribute__((target("avx2"))) inline int intersectAVX2(const hashCode* a, int n, const hashCode* b, int m, int* ia, int* ib) {
+        int i = 0, j = 0, cnt = 0;
+        while (i + 4 <= n && j + 4 <= m) {
+            __m256i va = _mm256_loadu_si256((const __m256i*)(a + i)), vb = _mm256_loadu_si256((const __m256i*)(b + j));
+            int hit[4] = {-1, -1, -1, -1}; //a 的第 k 个和 b 的哪一个相等
+            for (int r = 0; r < 4; ++r) {
+                int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(va, vb)));
+                for (int k = 0; k < 4; ++k) if (mask >> k & 1) hit[k] = (k + r) & 3;
+                vb = _mm256_permute4x64_epi64(vb, 0x39); //左移一位：第 k 道变成原来的第 k+1 道
+            }
+            for (int k = 0; k < 4; ++k) if (hit[k] != -1) ia[cnt] = i + k, ib[cnt++] = j + hit[k];
+            //块尾较小的一边整块都比完了
+            hashCode lastA = a[i+3], lastB = b[j+3];
+            if (lastA <= lastB) i += 4;
+            if (lastB <= lastA) j += 4;
+        }
+        return intersectScalar(a, n, b, m, ia, ib, i, j, cnt);
+    }
+#endif
+
+    inline int intersect(const hashCode* a, int n, const hashCode* b, int m, int* ia, int* ib) {
+        if (!n || !m) return 0;
+        if (n >= m * Gallop_Ratio || m >= n * Gallop_Ratio) return intersectGallop(a, n, b, m, ia, ib);
+#ifdef SIRIUS_X86_SIMD
+        if (simdLevel() == 2) return intersectAVX2(a, n, b, m, ia, ib);
+#endif
+        return intersectScalar(a, n, b, m, ia, ib);
+    }
+}
+
+#endif //TICKETSYSTEM_2021_MAIN_INTERSECT_HPP
@@ -0,0 +1,65 @@
+//
+// Created by SiriusNEO.
+//
+
+#ifndef TICKETSYSTEM_2021_MAIN_LINEREADER_HPP
+#define TICKETSYSTEM_2021_MAIN_LINEREADER_HPP
+
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <functional>
+
+namespace Sirius {
+    /* 按大块读输入，逐行交出缓冲区里的行（'\n' 改成 '\0'，原地可写），不复制
+     * 读到半行时把它挪到缓冲区开头再接着读，一行比缓冲区还长就扩容，没有行长上限
+     * 用 read 而不是 fread：管道、终端上有多少先交多少，交互时不会等满一块
+     * 每次要 read 之前先调 beforeRead（main 里用它把攒着的输出交出去，流水线模式用它把攒着的命令交出去）
+     */
+    class LineReader {
+    private:
+        static constexpr int Block_Size = 1 << 20;
+        int fd;
+        std::function<void()> beforeRead;
+        char* buf;
+        int cap, begin, end; //[begin, end) 是还没交出去的数据
+        bool eof;
+
+    public:
+        explicit LineReader(int _fd = 0, std::function<void()> _beforeRead = nullptr):fd(_fd), beforeRead(_beforeRead), buf(new char[Block_Size * 2]), cap(Block_Size * 2), begin(0), end(0), eof(false) {}
+        ~LineReader() {
+            if (fd > 0) close(fd);
+            delete[] buf;
+        }
+
+        char* nextLine() { //读完返回 nullptr
+            while (true) {
+                char* nl = (char*)memchr(buf + begin, '\n', end - begin);
+                if (nl) {
+                    char* line = buf + begin;
+                    *nl = '\0', begin = nl - buf + 1;
+                    return line;
+                }
+                if (eof) { //最后一行没有换行符
+                    if (begin == end) return nullptr;
+                    char* line = buf + begin;
+                    buf[end] = '\0', begin = end;
+                    return line;
+                }
+                if (begin) memmove(buf, buf + begin, end - begin), end -= begin, begin = 0;
+                if (cap - end - 1 < Block_Size) { //留一个字节给结尾的 '\0'
+                    char* newBuf = new char[cap * 2];
+                    memcpy(newBuf, buf, end);
+                    delete[] buf;
+                    buf = newBuf, cap *= 2;
+                }
+                if (beforeRead) beforeRead();
+                ssize_t got = read(fd, buf + end, cap - end - 1);
+                if (got <= 0) eof = true;
+                else end += got;
+            }
+        }
+    };
+}
+
+#endif //TICKETSYSTEM_2021_MAIN_LINEREADER_HPP
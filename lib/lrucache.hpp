@@ -0,0 +1,94 @@
+//
+// Created by SiriusNEO.
+//
+
+#ifndef TICKETSYSTEM_2021_MAIN_LRUCACHE_HPP
+#define TICKETSYSTEM_2021_MAIN_LRUCACHE_HPP
+
+#include "mytools.hpp"
+
+namespace Sirius {
+    /* 定长 LRU 对象缓存，键是 hashCode
+     * 槽位一次性开好，用下标串成双向链表（表头最近使用）；键 -> 槽位用拉链哈希
+     * 返回的指针在下一次 insert 之前有效
+     */
+    template<class Value, int Capacity>
+    class LRUCache {
+    private:
+        static constexpr int Bucket = Capacity * 2;
+        hashCode keys[Capacity];
+        Value* vals;
+        int prev[Capacity], next[Capacity], chain[Capacity], bucket[Bucket];
+        int head, tail, used; //head 最近使用，tail 最久未用
+
+        void unlink(int p) {
+            if (prev[p] != -1) next[prev[p]] = next[p]; else head = next[p];
+            if (next[p] != -1) prev[next[p]] = prev[p]; else tail = prev[p];
+        }
+        void pushFront(int p) {
+            prev[p] = -1, next[p] = head;
+            if (head != -1) prev[head] = p; else tail = p;
+            head = p;
+        }
+        void unhash(int p) {
+            int* q = &bucket[keys[p] % Bucket];
+            while (*q != p) q = &chain[*q];
+            *q = chain[p];
+        }
+        int locate(const hashCode& key) const {
+            int p = bucket[key % Bucket];
+            while (p != -1 && keys[p] != key) p = chain[p];
+            return p;
+        }
+
+    public:
+        LRUCache():vals(new Value[Capacity]) {clear();}
+        ~LRUCache() {delete[] vals;}
+
+        Value* find(const hashCode& key) {
+            int p = locate(key);
+            if (p == -1) return nullptr;
+            if (p != head) unlink(p), pushFront(p);
+            return vals + p;
+        }
+        Value* peek(const hashCode& key) { //只查不动顺序
+            int p = locate(key);
+            return p == -1 ? nullptr : vals + p;
+        }
+        //给 key 腾一个槽位（满了就换掉最久未用的）并返回，内容由调用者填
+        Value* insert(const hashCode& key) {
+            int p = locate(key);
+            if (p != -1) {
+                if (p != head) unlink(p), pushFront(p);
+                return vals + p;
+            }
+            if (used < Capacity) p = used++;
+            else p = tail, unlink(p), unhash(p);
+            keys[p] = key, chain[p] = bucket[key % Bucket], bucket[key % Bucket] = p;
+            pushFront(p);
+            return vals + p;
+        }
+        void erase(const hashCode& key) {
+            int p = locate(key);
+            if (p == -1) return;
+            unlink(p), unhash(p);
+            //把最后一个槽位挪过来，保持 [0, used) 都在用
+            int last = --used;
+            if (p != last) {
+                keys[p] = keys[last], vals[p] = vals[last];
+                prev[p] = prev[last], next[p] = next[last];
+                if (prev[p] != -1) next[prev[p]] = p; else head = p;
+                if (next[p] != -1) prev[next[p]] = p; else tail = p;
+                int* q = &bucket[keys[p] % Bucket];
+                while (*q != last) q = &chain[*q];
+                *q = p, chain[p] = chain[last];
+            }
+        }
+        void clear() {
+            head = tail = -1, used = 0;
+            for (int i = 0; i < Bucket; ++i) bucket[i] = -1;
+        }
+    };
+}
+
+#endif //TICKETSYSTEM_2021_MAIN_LRUCACHE_HPP
@@ -10,6 +10,7 @@
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
+#include <algorithm>
 
 //for debug
 #define BOMB std::cout<<"bomb\n";
@@ -23,30 +24,79 @@ namespace Sirius {
 
     typedef unsigned long long hashCode;
 
-    /* FixedStr */
-    template<int SIZE>
-    struct FixedStr { /* Warning: Don't use too long string to initialize it. */
-        char str[SIZE];
-        FixedStr():str() {}
-        FixedStr(const std::string& _str):str() {
-            strcpy(str, _str.c_str());
+    /* StrRef：别处缓冲区里的一段字符，不拥有内存、不保证以 '\0' 结尾；解析命令用，不分配 */
+    struct StrRef {
+        const char* str;
+        int len;
+        StrRef():str(""), len(0) {}
+        StrRef(const char* _str, int _len):str(_str), len(_len) {}
+        int size() const {return len;}
+        bool empty() const {return !len;}
+        char operator [] (int pos) const {
+            return str[pos];
+        }
+        bool operator == (const StrRef& obj) const {
+            return len == obj.len && memcmp(str, obj.str, len) == 0;
         }
-        FixedStr(const char* _str):str() {
-            strcpy(str, _str);
+        bool operator != (const StrRef& obj) const {return !(*this == obj);}
+        bool operator == (const char* obj) const {
+            return strncmp(str, obj, len) == 0 && !obj[len];
         }
-        char& operator [] (int pos) {
+        bool operator != (const char* obj) const {return !(*this == obj);}
+        std::string toString() const {return std::string(str, len);}
+    };
+
+    /* FixedStr
+     * 定长、补零到 8 字节整数倍的缓冲区，外加存好的长度；超长的输入截到 SIZE-1
+     * 比较按 8 字节一个字做：相等直接比字，大小把字转成大端再比（补的 0 比任何字符小，结果和 strcmp 一致）
+     */
+    template<int SIZE>
+    struct FixedStr {
+        static_assert(SIZE < 256, "len is stored in one byte");
+        static constexpr int Words = (SIZE + 7) / 8;
+        char str[Words * 8];
+        unsigned char len;
+
+        FixedStr():str(), len(0) {}
+        FixedStr(const char* _str, int _len):str(), len(std::min(_len, SIZE - 1)) {
+            memcpy(str, _str, len);
+        }
+        FixedStr(const std::string& _str):FixedStr(_str.c_str(), _str.size()) {}
+        FixedStr(const char* _str):FixedStr(_str, strlen(_str)) {}
+        FixedStr(const StrRef& _str):FixedStr(_str.str, _str.len) {}
+
+        int size() const {return len;}
+        char operator [] (int pos) const {
             return str[pos];
         }
-        bool operator < (const FixedStr<SIZE>& obj) const {
-            return strcmp(str, obj.str) < 0;
+        hashCode word(int i) const { //第 i 个 8 字节字（本机字节序）
+            hashCode ret;
+            memcpy(&ret, str + i * 8, 8);
+            return ret;
+        }
+        hashCode orderWord(int i) const { //第 i 个字按大端解释，比较大小用
+            return __builtin_bswap64(word(i));
+        }
+        int compare(const FixedStr<SIZE>& obj) const { //三路比较：<0、0、>0
+            int n = (std::max(len, obj.len) >> 3) + 1;
+            if (n > Words) n = Words;
+            for (int i = 0; i < n; ++i) {
+                hashCode a = word(i), b = obj.word(i);
+                if (a != b) return __builtin_bswap64(a) < __builtin_bswap64(b) ? -1 : 1;
+            }
+            return 0;
         }
         bool operator == (const FixedStr<SIZE>& obj) const {
-            return strcmp(str, obj.str) == 0;
+            if (len != obj.len) return false;
+            for (int i = 0, n = std::min((len >> 3) + 1, Words); i < n; ++i)
+                if (word(i) != obj.word(i)) return false;
+            return true;
         }
-        bool operator <= (const FixedStr<SIZE>& obj) const {return *this < obj || *this == obj;}
-        bool operator > (const FixedStr<SIZE>& obj) const {return !(*this <= obj);}
-        bool operator >= (const FixedStr<SIZE>& obj) const {return !(*this < obj);}
-        bool operator != (const FixedStr<SIZE>& obj) const {return !(*this==obj);}
+        bool operator != (const FixedStr<SIZE>& obj) const {return !(*this == obj);}
+        bool operator < (const FixedStr<SIZE>& obj) const {return compare(obj) < 0;}
+        bool operator <= (const FixedStr<SIZE>& obj) const {return compare(obj) <= 0;}
+        bool operator > (const FixedStr<SIZE>& obj) const {return compare(obj) > 0;}
+        bool operator >= (const FixedStr<SIZE>& obj) const {return compare(obj) >= 0;}
 
         friend std::ostream& operator << (std::ostream& os, const FixedStr& obj) {
             return os << obj.str;
@@ -101,12 +151,88 @@ namespace Sirius {
         int size(){return siz;}
     };
 
+    /* Vector */
+    template<class T>
+    class Vector {
+    private:
+        T* buf;
+        int siz, cap;
+        void grow(int need) {
+            if (need <= cap) return;
+            int newCap = std::max(need, cap << 1);
+            T* newBuf = new T[newCap];
+            for (int i = 0; i < siz; ++i) newBuf[i] = buf[i];
+            delete[] buf;
+            buf = newBuf, cap = newCap;
+        }
+    public:
+        Vector():buf(nullptr), siz(0), cap(0) {}
+        Vector(const Vector& obj):buf(nullptr), siz(0), cap(0) {*this = obj;}
+        ~Vector() {delete[] buf;}
+        Vector& operator = (const Vector& obj) {
+            if (this == &obj) return *this;
+            siz = 0, grow(obj.siz);
+            for (int i = 0; i < obj.siz; ++i) buf[i] = obj.buf[i];
+            siz = obj.siz;
+            return *this;
+        }
+        T& operator [] (int pos) {return buf[pos];}
+        const T& operator [] (int pos) const {return buf[pos];}
+        T* begin() {return buf;}
+        T* end() {return buf + siz;}
+        const T* begin() const {return buf;}
+        const T* end() const {return buf + siz;}
+        int size() const {return siz;}
+        bool empty() const {return !siz;}
+        void clear() {siz = 0;}
+        void resize(int n) {grow(n), siz = n;}
+        void push_back(const T& x) {grow(siz + 1), buf[siz++] = x;}
+        void insert(int pos, const T& x) {
+            grow(siz + 1);
+            for (int i = siz; i > pos; --i) buf[i] = buf[i-1];
+            buf[pos] = x, siz++;
+        }
+        void erase(int pos) {
+            for (int i = pos; i < siz-1; ++i) buf[i] = buf[i+1];
+            siz--;
+        }
+    };
+
+    /* Heap: 小根堆 */
+    template<class T>
+    class Heap {
+    private:
+        Vector<T> a;
+    public:
+        int size() const {return a.size();}
+        bool empty() const {return a.empty();}
+        const T& top() const {return a[0];}
+        void push(const T& x) {
+            a.push_back(x);
+            for (int p = a.size()-1; p && a[p] < a[(p-1)>>1]; p = (p-1)>>1) std::swap(a[p], a[(p-1)>>1]);
+        }
+        void pop() {
+            a[0] = a[a.size()-1], a.erase(a.size()-1);
+            for (int p = 0, c; (c = (p<<1)+1) < a.size(); p = c) {
+                if (c+1 < a.size() && a[c+1] < a[c]) ++c;
+                if (!(a[c] < a[p])) break;
+                std::swap(a[p], a[c]);
+            }
+        }
+        void clear() {a.clear();}
+    };
+
     /* Processor */
     int stringToInt(const std::string& str) {
         int ret = 0;
         for (auto ch : str) ret = ret * 10 + ch - '0';
         return ret;
     }
+    int stringToInt(const StrRef& str) {
+        int ret = 0;
+        for (int i = 0; i < str.len; ++i) ret = ret * 10 + str.str[i] - '0';
+        return ret;
+    }
 
     std::string dateFormat(int num) {
         if (num < 10) return "0"+std::to_string(num);
@@ -123,6 +249,15 @@ namespace Sirius {
             i = j;
         }
     }
+    void split(const StrRef& originStr, StrRef ret[], int& retc, char delim) { //切成原串上的片段，不复制
+        retc = 0;
+        for (int i = 0, j = 0; i < originStr.len; ) {
+            while (j < originStr.len && originStr.str[j] != delim) ++j;
+            ret[retc++] = StrRef(originStr.str + i, j - i);
+            while (j < originStr.len && originStr.str[j] == delim) ++j;
+            i = j;
+        }
+    }
 
     /* Char Validator */
     inline bool isDigit(char ch) {return ch>='0'&&ch<='9';}
@@ -131,18 +266,78 @@ namespace Sirius {
     inline bool isLetter(char ch) {return isUpperLetter(ch)||isLowerLetter(ch);}
 
     /* Algorithm */
-    template <class T>
-    void qsort(T* l, T* r, bool (*cmp)(const T&, const T&)) {
-        if (l >= r) return;
-        T *i = l, *j = r, x = *i;
-        while (i < j) {
-            while (i < j && cmp(x, *j)) j--;
-            if (i < j) *i = *j, i++;
-            while (i < j && cmp(*i, x)) i++;
-            if (i < j) *j = *i, j--;
+    //以下排序均为左闭右开 [l, r)
+    template<class T, class Cmp>
+    void insertionSort(T* l, T* r, Cmp cmp) {
+        for (T* i = l + 1; i < r; ++i) {
+            T x = *i, *j = i;
+            for (; j > l && cmp(x, *(j-1)); --j) *j = *(j-1);
+            *j = x;
+        }
+    }
+
+    template<class T, class Cmp>
+    void heapSort(T* l, T* r, Cmp cmp) {
+        int n = r - l;
+        auto sift = [&](int p, int len) {
+            for (int c; (c = (p<<1)+1) < len; p = c) {
+                if (c+1 < len && cmp(l[c], l[c+1])) ++c;
+                if (!cmp(l[p], l[c])) break;
+                std::swap(l[p], l[c]);
+            }
+        };
+        for (int i = n/2-1; i >= 0; --i) sift(i, n);
+        for (int i = n-1; i > 0; --i) std::swap(l[0], l[i]), sift(0, i);
+    }
+
+    //introsort：三数取中的快排，递归超过 2log n 层改堆排，小区间插入排序，最坏 O(n log n)
+    template<class T, class Cmp>
+    void introSort(T* l, T* r, Cmp cmp, int depth = -1) {
+        if (depth < 0) {depth = 0; for (int n = r - l; n > 1; n >>= 1) depth += 2;}
+        while (r - l > 16) {
+            if (!depth--) {heapSort(l, r, cmp); return;}
+            T *mid = l + ((r - l) >> 1), *last = r - 1;
+            if (cmp(*mid, *l)) std::swap(*mid, *l);
+            if (cmp(*last, *mid)) std::swap(*last, *mid);
+            if (cmp(*mid, *l)) std::swap(*mid, *l);
+            T pivot = *mid, *i = l, *j = last;
+            while (true) {
+                while (cmp(*i, pivot)) ++i;
+                while (cmp(pivot, *j)) --j;
+                if (i >= j) break;
+                std::swap(*i, *j), ++i, --j;
+            }
+            introSort(j + 1, r, cmp, depth); //右半递归，左半循环
+            r = j + 1;
+        }
+        insertionSort(l, r, cmp);
+    }
+
+    //LSD 基数排序（稳定），按 key(x) 的低 bits 位，每趟 8 位，所有元素这一位都相同的趟跳过；buf 与 a 等长
+    template<class T, class Key>
+    void radixSort(T* a, T* buf, int n, Key key, int bits = 64) {
+        T *from = a, *to = buf;
+        for (int shift = 0; shift < bits; shift += 8) {
+            int cnt[257] = {0};
+            for (int i = 0; i < n; ++i) ++cnt[(key(from[i]) >> shift & 255) + 1];
+            if (cnt[(key(from[0]) >> shift & 255) + 1] == n) continue;
+            for (int i = 0; i < 256; ++i) cnt[i+1] += cnt[i];
+            for (int i = 0; i < n; ++i) to[cnt[key(from[i]) >> shift & 255]++] = from[i];
+            std::swap(from, to);
         }
-        *i = x;
-        qsort(l, i-1, cmp); qsort(i+1, r, cmp);
+        if (from != a) for (int i = 0; i < n; ++i) a[i] = from[i];
+    }
+
+    /* Pack: 变长记录的逐字段序列化 */
+    template<class T>
+    inline void packItem(char*& p, const T* src, int n = 1) {
+        memcpy(p, src, sizeof(T) * n);
+        p += sizeof(T) * n;
+    }
+    template<class T>
+    inline void unpackItem(const char*& p, T* dst, int n = 1) {
+        memcpy(dst, p, sizeof(T) * n);
+        p += sizeof(T) * n;
     }
 
     /* Random */
@@ -162,26 +357,134 @@ namespace Sirius {
         return ret;
     }
 
-    /* Hash */
-    constexpr int HashSeed = 131;
-    hashCode hash(const char* nowStr) {
+    /* Hash
+     * 一次读 8 字节，乘法折叠（wyhash 的 mum）混合，读到含 '\0' 的那个字后停
+     * 串后面补的都是 0，所以 FixedStr 按整个缓冲区算和按 strlen 算结果一样；结果右移 4 位保证小于 LL_Max
+     */
+    constexpr hashCode HashSeed0 = 0xa0761d6478bd642full, HashSeed1 = 0xe7037ed1a0b428dbull;
+    constexpr hashCode hashMum(hashCode a, hashCode b) {
+        unsigned __int128 r = (unsigned __int128)a * b;
+        return (hashCode)(r >> 64) ^ (hashCode)r;
+    }
+    inline hashCode hashBytes(const char* s, int len) { //len 含结尾的 '\0'
+        hashCode h = HashSeed0;
+        for (int i = 0; i < len; i += 8) {
+            hashCode w = 0;
+            memcpy(&w, s + i, std::min(8, len - i));
+            h = hashMum(h ^ w, HashSeed1);
+            if ((w - 0x0101010101010101ull) & ~w & 0x8080808080808080ull) break; //这个字里有 '\0'
+        }
+        return hashMum(h, HashSeed0 ^ HashSeed1) >> 4;
+    }
+    inline hashCode hash(const char* nowStr) {
+        return hashBytes(nowStr, strlen(nowStr) + 1);
+    }
+    constexpr hashCode EmptyHash = hashMum(hashMum(HashSeed0, HashSeed1), HashSeed0 ^ HashSeed1) >> 4; //hash("")
+    //旧版逐字节多项式 hash：只用来保持 query_transfer 平局时的先后次序（以前按它排序）
+    constexpr int PolySeed = 131;
+    inline hashCode polyHash(const char* nowStr) {
         unsigned long long ret = 0;
         const char* p = nowStr;
-        while (*p) ret = ret * HashSeed + (*p++) - '0';
+        while (*p) ret = ret * PolySeed + (*p++) - '0';
         return ret % LL_Max;
     }
 
-    /* Fastout */
-    void write(const char* str) {
-        fwrite(str, sizeof(char), strlen(str), stdout);
+    /* 带缓存 hash 的 FixedStr，用作 ID 类型：构造时算一次，判等先比 hash */
+    template<int SIZE>
+    struct HashedStr : public FixedStr<SIZE> {
+        hashCode code;
+        HashedStr():FixedStr<SIZE>(), code(EmptyHash) {}
+        HashedStr(const std::string& _str):FixedStr<SIZE>(_str), code(hashBytes(this->str, this->len + 1)) {}
+        HashedStr(const char* _str):FixedStr<SIZE>(_str), code(hashBytes(this->str, this->len + 1)) {}
+        HashedStr(const StrRef& _str):FixedStr<SIZE>(_str), code(hashBytes(this->str, this->len + 1)) {}
+        bool operator == (const HashedStr<SIZE>& obj) const {
+            return code == obj.code && FixedStr<SIZE>::operator==(obj);
+        }
+        bool operator != (const HashedStr<SIZE>& obj) const {return !(*this == obj);}
+    };
+
+    /* Fastout：所有输出先写进一块可复用的缓冲区，攒够一批（或要等输入时）再一次 fwrite
+     * 一条命令执行期间不会 flush，所以它的输出在缓冲区里是连续的一段（结果缓存按位置截取）
+     */
+    class OutBuffer {
+    private:
+        char* buf;
+        int len, cap;
+
+    public:
+        static constexpr int Flush_Size = 1 << 16;
+        OutBuffer():buf(new char[Flush_Size * 2]), len(0), cap(Flush_Size * 2) {}
+        ~OutBuffer() {flush(), delete[] buf;}
+
+        char* reserve(int n) { //保证后面至少有 n 个字节可写，写完用 commit(n) 确认
+            if (len + n > cap) {
+                while (len + n > cap) cap <<= 1;
+                char* newBuf = new char[cap];
+                memcpy(newBuf, buf, len);
+                delete[] buf;
+                buf = newBuf;
+            }
+            return buf + len;
+        }
+        void commit(int n) {len += n;}
+        void put(char ch) {*reserve(1) = ch, ++len;}
+        void put(const char* str, int n) {memcpy(reserve(n), str, n), len += n;}
+        const char* data() const {return buf;}
+        void clear() {len = 0;}
+        int size() const {return len;}
+        void swap(OutBuffer& other) { //流水线模式下和写出线程交换缓冲区
+            std::swap(buf, other.buf), std::swap(len, other.len), std::swap(cap, other.cap);
+        }
+        void flush() {
+            if (!len) return;
+            fwrite(buf, sizeof(char), len, stdout), fflush(stdout);
+            len = 0;
+        }
+    };
+    OutBuffer output;
+    thread_local OutBuffer* curOutput = &output; //write* 写到这里；并行执行只读命令时每个线程指向自己的缓冲区
+
+    struct DigitTable { //0~99 的两位十进制字符
+        char pair[200];
+        constexpr DigitTable():pair() {
+            for (int i = 0; i < 100; ++i) pair[i*2] = '0' + i / 10, pair[i*2+1] = '0' + i % 10;
+        }
+    };
+    constexpr DigitTable Digits;
+    inline void putTwoDigits(char* p, int x) { //0 <= x < 100
+        p[0] = Digits.pair[x*2], p[1] = Digits.pair[x*2+1];
+    }
+
+    inline void writeChar(char ch) {
+        curOutput->put(ch);
+    }
+
+    inline void write(const char* str, int len) {
+        curOutput->put(str, len);
+    }
+
+    inline void write(const char* str) {
+        curOutput->put(str, strlen(str));
+    }
+
+    inline void write(const StrRef& str) {
+        curOutput->put(str.str, str.len);
+    }
+
+    template<int SIZE>
+    inline void write(const FixedStr<SIZE>& str) { //长度是存好的，不用 strlen
+        curOutput->put(str.str, str.len);
     }
 
-    void writeInt(int x) {
-        if (!x) {putchar('0');return;}
-        char ret[33];
-        int p = 0;
-        while (x) ret[p++] = (x%10)+48, x /= 10;
-        while (p) --p, putchar(ret[p]);
+    inline void writeInt(long long x) {
+        char ret[24];
+        int p = 24;
+        unsigned long long u = x < 0 ? -(unsigned long long)x : x;
+        while (u >= 100) p -= 2, putTwoDigits(ret + p, u % 100), u /= 100;
+        if (u >= 10) p -= 2, putTwoDigits(ret + p, u);
+        else ret[--p] = '0' + u;
+        if (x < 0) ret[--p] = '-';
+        curOutput->put(ret + p, 24 - p);
     }
 }
 
@@ -0,0 +1,102 @@
+//
+// Created by SiriusNEO.
+//
+
+#ifndef TICKETSYSTEM_2021_MAIN_SEATOPS_HPP
+#define TICKETSYSTEM_2021_MAIN_SEATOPS_HPP
+
+#include "mytools.hpp"
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIRIUS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace Sirius {
+    /* 座位区间的 min / add 核心：对一行座位做向量化扫描（AVX2 / SSE4.1，运行时按 CPU 选择，否则标量）
+     * bench/seat_bench.cpp 里和懒标记线段树比过：100 段以内（题目允许的所有车次）扫描总是更快，所以不用线段树
+     */
+
+    inline int rangeMinScalar(const int* a, int l, int r) {
+        int ret = Int_Max;
+        for (int i = l; i <= r; ++i) ret = std::min(ret, a[i]);
+        return ret;
+    }
+
+    inline void rangeAddScalar(int* a, int l, int r, int val) {
+        for (int i = l; i <= r; ++i) a[i] += val;
+    }
+
+#ifdef SIRIUS_X86_SIMD
+    __attribute__((target("avx2"))) inline int rangeMinAVX2(const int* a, int l, int r) {
+        int i = l, ret = Int_Max;
+        if (r - l + 1 >= 8) {
+            __m256i mn = _mm256_set1_epi32(Int_Max);
+            for (; i + 8 <= r + 1; i += 8) mn = _mm256_min_epi32(mn, _mm256_loadu_si256((const __m256i*)(a + i)));
+            __m128i m = _mm_min_epi32(_mm256_castsi256_si128(mn), _mm256_extracti128_si256(mn, 1));
+            m = _mm_min_epi32(m, _mm_shuffle_epi32(m, 0x4e));
+            m = _mm_min_epi32(m, _mm_shuffle_epi32(m, 0xb1));
+            ret = _mm_cvtsi128_si32(m);
+        }
+        for (; i <= r; ++i) ret = std::min(ret, a[i]);
+        return ret;
+    }
+
+    __attribute__((target("avx2"))) inline void rangeAddAVX2(int* a, int l, int r, int val) {
+        int i = l;
+        __m256i v = _mm256_set1_epi32(val);
+        for (; i + 8 <= r + 1; i += 8)
+            _mm256_storeu_si256((__m256i*)(a + i), _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(a + i)), v));
+        for (; i <= r; ++i) a[i] += val;
+    }
+
+    __attribute__((target("sse4.1"))) inline int rangeMinSSE41(const int* a, int l, int r) {
+        int i = l, ret = Int_Max;
+        if (r - l + 1 >= 4) {
+            __m128i m = _mm_set1_epi32(Int_Max);
+            for (; i + 4 <= r + 1; i += 4) m = _mm_min_epi32(m, _mm_loadu_si128((const __m128i*)(a + i)));
+            m = _mm_min_epi32(m, _mm_shuffle_epi32(m, 0x4e));
+            m = _mm_min_epi32(m, _mm_shuffle_epi32(m, 0xb1));
+            ret = _mm_cvtsi128_si32(m);
+        }
+        for (; i <= r; ++i) ret = std::min(ret, a[i]);
+        return ret;
+    }
+
+    inline void rangeAddSSE2(int* a, int l, int r, int val) {
+        int i = l;
+        __m128i v = _mm_set1_epi32(val);
+        for (; i + 4 <= r + 1; i += 4)
+            _mm_storeu_si128((__m128i*)(a + i), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(a + i)), v));
+        for (; i <= r; ++i) a[i] += val;
+    }
+
+    inline int simdLevel() { //2: AVX2, 1: SSE4.1, 0: 标量
+        static const int level = __builtin_cpu_supports("avx2") ? 2 : (__builtin_cpu_supports("sse4.1") ? 1 : 0);
+        return level;
+    }
+#endif
+
+    //闭区间 [l, r]
+    inline int rangeMin(const int* a, int l, int r) {
+#ifdef SIRIUS_X86_SIMD
+        switch (simdLevel()) {
+            case 2: return rangeMinAVX2(a, l, r);
+            case 1: return rangeMinSSE41(a, l, r);
+        }
+#endif
+        return rangeMinScalar(a, l, r);
+    }
+
+    inline void rangeAdd(int* a, int l, int r, int val) {
+#ifdef SIRIUS_X86_SIMD
+        if (simdLevel() == 2) {rangeAddAVX2(a, l, r, val); return;}
+        rangeAddSSE2(a, l, r, val);
+#else
+        rangeAddScalar(a, l, r, val);
+#endif
+    }
+}
+
+#endif //TICKETSYSTEM_2021_MAIN_SEATOPS_HPP
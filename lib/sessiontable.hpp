@@ -0,0 +1,81 @@
+//
+// Created by SiriusNEO.
+//
+
+#ifndef TICKETSYSTEM_2021_MAIN_SESSIONTABLE_HPP
+#define TICKETSYSTEM_2021_MAIN_SESSIONTABLE_HPP
+
+#include "mytools.hpp"
+
+namespace Sirius {
+    /* 已登录用户表：hashCode -> 用户记录，开放寻址（线性探测）
+     * 不同用户的 hash 可能相同，查找、删除时由调用者给的 same(record) 确认是不是要找的那个
+     * 删除留墓碑，墓碑和在用槽位合计超过 3/4 时按在用数重建，把墓碑回收掉
+     */
+    template<class Record>
+    class SessionTable {
+    private:
+        enum slotState : char {EMPTY, USED, TOMB};
+        hashCode* keys;
+        Record* vals;
+        slotState* state;
+        int cap, used, tombs;
+
+        static hashCode mix(hashCode x) {
+            x ^= x >> 31, x *= 0x7FB5D329728EA185ull, x ^= x >> 27;
+            return x;
+        }
+        void init(int _cap) {
+            cap = _cap, used = tombs = 0;
+            keys = new hashCode[cap], vals = new Record[cap], state = new slotState[cap];
+            for (int i = 0; i < cap; ++i) state[i] = EMPTY;
+        }
+        void release() {delete[] keys, delete[] vals, delete[] state;}
+        void rebuild(int _cap) {
+            hashCode* oldKeys = keys;
+            Record* oldVals = vals;
+            slotState* oldState = state;
+            int oldCap = cap;
+            init(_cap);
+            for (int i = 0; i < oldCap; ++i) if (oldState[i] == USED) insert(oldKeys[i], oldVals[i]);
+            delete[] oldKeys, delete[] oldVals, delete[] oldState;
+        }
+        template<class Same>
+        int locate(const hashCode& key, Same same) const { //记录所在槽位，没有返回 -1
+            for (int p = mix(key) & (cap-1); state[p] != EMPTY; p = (p+1) & (cap-1))
+                if (state[p] == USED && keys[p] == key && same(vals[p])) return p;
+            return -1;
+        }
+
+    public:
+        SessionTable() {init(16);}
+        ~SessionTable() {release();}
+
+        template<class Same>
+        Record* find(const hashCode& key, Same same) { //未登录返回 nullptr
+            int p = locate(key, same);
+            return p == -1 ? nullptr : vals + p;
+        }
+        void insert(const hashCode& key, const Record& val) { //调用者保证表里还没有这条记录
+            int p = mix(key) & (cap-1);
+            while (state[p] == USED) p = (p+1) & (cap-1);
+            if (state[p] == TOMB) --tombs;
+            keys[p] = key, vals[p] = val, state[p] = USED, ++used;
+            if ((used + tombs) * 4 > cap * 3) {
+                int newCap = 16;
+                while (newCap < used * 4) newCap <<= 1;
+                rebuild(newCap);
+            }
+        }
+        template<class Same>
+        void erase(const hashCode& key, Same same) {
+            int p = locate(key, same);
+            if (p == -1) return;
+            state[p] = TOMB, --used, ++tombs;
+        }
+        int size() const {return used;}
+        void clear() {release(), init(16);}
+    };
+}
+
+#endif //TICKETSYSTEM_2021_MAIN_SESSIONTABLE_HPP
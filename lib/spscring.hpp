@@ -0,0 +1,48 @@
+//
+// Created by SiriusNEO.
+//
+
+#ifndef TICKETSYSTEM_2021_MAIN_SPSCRING_HPP
+#define TICKETSYSTEM_2021_MAIN_SPSCRING_HPP
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+namespace Sirius {
+    /* 单生产者单消费者的无锁环形队列，容量是 2 的幂
+     * head 只有消费者写、tail 只有生产者写，各占一条缓存行；满了/空了就先让出时间片，等久了再睡一小会，空闲时不一直占着核
+     */
+    template<class T, int Capacity>
+    class SpscRing {
+        static_assert((Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+    private:
+        T items[Capacity];
+        alignas(64) std::atomic<unsigned> head; //下一个要取的
+        alignas(64) std::atomic<unsigned> tail; //下一个要放的
+
+        static void backoff(int& spins) {
+            if (++spins < 256) std::this_thread::yield();
+            else std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+
+    public:
+        SpscRing():items(), head(0), tail(0) {}
+
+        void push(const T& val) { //满了就等
+            unsigned t = tail.load(std::memory_order_relaxed);
+            for (int spins = 0; t - head.load(std::memory_order_acquire) == Capacity; ) backoff(spins);
+            items[t & (Capacity - 1)] = val;
+            tail.store(t + 1, std::memory_order_release);
+        }
+        T pop() { //空了就等
+            unsigned h = head.load(std::memory_order_relaxed);
+            for (int spins = 0; tail.load(std::memory_order_acquire) == h; ) backoff(spins);
+            T val = items[h & (Capacity - 1)];
+            head.store(h + 1, std::memory_order_release);
+            return val;
+        }
+    };
+}
+
+#endif //TICKETSYSTEM_2021_MAIN_SPSCRING_HPP
@@ -0,0 +1,71 @@
+//
+// Created by SiriusNEO.
+//
+
+#ifndef TICKETSYSTEM_2021_MAIN_THREADPOOL_HPP
+#define TICKETSYSTEM_2021_MAIN_THREADPOOL_HPP
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace Sirius {
+    /* 固定大小的线程池，只支持一种用法：run(f) 让每个线程（含调用者，编号 0）各跑一次 f(id)，全部结束后返回
+     * 任务怎么切由 f 自己决定（一般是共享一个 atomic 游标抢块）
+     */
+    class ThreadPool {
+    private:
+        std::thread* workers;
+        int num; //总线程数，含调用者
+        std::mutex mtx;
+        std::condition_variable startCv, doneCv;
+        const std::function<void(int)>* task;
+        int round, running;
+        bool stop;
+
+        void loop(int id) {
+            int seen = 0;
+            while (true) {
+                std::unique_lock<std::mutex> lock(mtx);
+                startCv.wait(lock, [&]{return stop || round != seen;});
+                if (stop) return;
+                seen = round;
+                lock.unlock();
+                (*task)(id);
+                lock.lock();
+                if (!--running) doneCv.notify_one();
+            }
+        }
+
+    public:
+        explicit ThreadPool(int _num = std::thread::hardware_concurrency()):workers(nullptr), num(std::max(_num, 1)), task(nullptr), round(0), running(0), stop(false) {
+            if (num > 1) workers = new std::thread[num - 1];
+            for (int i = 1; i < num; ++i) workers[i-1] = std::thread(&ThreadPool::loop, this, i);
+        }
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                stop = true;
+            }
+            startCv.notify_all();
+            for (int i = 1; i < num; ++i) workers[i-1].join();
+            delete[] workers;
+        }
+        int size() const {return num;}
+
+        void run(const std::function<void(int)>& f) {
+            if (num == 1) {f(0); return;}
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                task = &f, running = num - 1, ++round;
+            }
+            startCv.notify_all();
+            f(0);
+            std::unique_lock<std::mutex> lock(mtx);
+            doneCv.wait(lock, [&]{return !running;});
+        }
+    };
+}
+
+#endif //TICKETSYSTEM_2021_MAIN_THREADPOOL_HPP
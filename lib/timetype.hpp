@@ -8,9 +8,18 @@
 #include "mytools.hpp"
 
 namespace Sirius {
-    const int PerMonthDay[] = {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31},
+    constexpr int PerMonthDay[] = {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31},
             MonthDaySum[] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365};
 
+    struct DateTable { //一年中的第几天 -> 月、日，格式化时不用二分
+        char month[365], day[365];
+        constexpr DateTable():month(), day() {
+            for (int m = 1, n = 0; m <= 12; ++m)
+                for (int d = 1; d <= PerMonthDay[m]; ++d, ++n) month[n] = m, day[n] = d;
+        }
+    };
+    constexpr DateTable Dates;
+
     //注意：对于纯日期，要 + " 00:00"，对于纯时刻，要 "01-01 "
     class TimeType {
     private:
@@ -18,20 +27,31 @@ namespace Sirius {
     public:
         TimeType():minute(0) {}
         TimeType(int _minute):minute(_minute){}
-        TimeType(const std::string& timeStr):minute(0) { //07-01 19:19
-            minute = ((MonthDaySum[stringToInt(timeStr.substr(0, 2))-1] + stringToInt(timeStr.substr(3, 2)) - 1) * 24
-                      + stringToInt(timeStr.substr(6, 2))) * 60
-                     + stringToInt(timeStr.substr(9, 2));
-        }
-
+        //直接从字符解析，不切子串：完整时间 "07-01 19:19"、纯日期 "07-01"（当天 00:00）、纯时刻 "19:19"（01-01 当天）
+        static int twoDigits(const char* p) {return (p[0] - '0') * 10 + p[1] - '0';}
+        static int parseDate(const char* p) {return (MonthDaySum[twoDigits(p)-1] + twoDigits(p + 3) - 1) * 24 * 60;}
+        static int parseClock(const char* p) {return twoDigits(p) * 60 + twoDigits(p + 3);}
+        TimeType(const char* timeStr):minute(parseDate(timeStr) + parseClock(timeStr + 6)) {}
+        TimeType(const std::string& timeStr):TimeType(timeStr.c_str()) {}
         TimeType& operator = (const std::string& timeStr) {
-            minute = ((MonthDaySum[stringToInt(timeStr.substr(0, 2))-1] + stringToInt(timeStr.substr(3, 2)) - 1) * 24
-                      + stringToInt(timeStr.substr(6, 2))) * 60
-                     + stringToInt(timeStr.substr(9, 2));
+            minute = parseDate(timeStr.c_str()) + parseClock(timeStr.c_str() + 6);
             return *this;
         }
+        static TimeType fromDate(const StrRef& dateStr) {
+            return TimeType(parseDate(dateStr.str));
+        }
+        static TimeType fromClock(const StrRef& clockStr) {
+            return TimeType(parseClock(clockStr.str));
+        }
+
+        bool inYear() const {return minute >= 0 && minute < 365 * 24 * 60;}
 
         std::pair<int, int> getDatePair() const {
+            if (inYear()) {
+                int dayNum = minute / (24*60);
+                return std::make_pair((int)Dates.month[dayNum], (int)Dates.day[dayNum]);
+            }
+            //超出一年：沿用二分（月份截在 12 月）
             int month = 0, day = 0, l = 1, r = 13;
             while (r - l != 1) {
                 int mid = (l + r) >> 1;
@@ -53,17 +73,32 @@ namespace Sirius {
             return TimeType(minute-minute%(24*60));
         }
 
+        int getDayNum() const { //从 01-01 起的第几天
+            return minute / (24*60);
+        }
+
         TimeType getClock() const {
             return TimeType(*this-this->getDate());
         }
 
         std::string toFormatString() const {
+            if (inYear()) {
+                char ret[11];
+                format(ret);
+                return std::string(ret, 11);
+            }
             auto date = getDatePair();
             int res = minute - (MonthDaySum[date.first-1] + date.second - 1) * 24 * 60,
             min = res % 60, hour = (res - min) / 60;
             return dateFormat(date.first)+"-"+dateFormat(date.second)+" "+dateFormat(hour)+":"+dateFormat(min);
         }
 
+        void format(char* p) const { //要求 inYear()；写 "mm-dd hh:mm" 共 11 个字符，不加 '\0'
+            int dayNum = minute / (24*60), res = minute % (24*60);
+            putTwoDigits(p, Dates.month[dayNum]), p[2] = '-', putTwoDigits(p + 3, Dates.day[dayNum]);
+            p[5] = ' ', putTwoDigits(p + 6, res / 60), p[8] = ':', putTwoDigits(p + 9, res % 60);
+        }
+
         TimeType operator + (const TimeType& obj) const {
             return TimeType(minute + obj.minute);
         }
@@ -100,6 +135,11 @@ namespace Sirius {
             return os << obj.toFormatString();
         }
     };
+
+    inline void writeTime(const TimeType& time) {
+        if (!time.inYear()) {write(time.toFormatString().c_str()); return;} //超出一年的少见情况走老路
+        time.format(curOutput->reserve(11)), curOutput->commit(11);
+    }
 }
 
 #endif //TICKETSYSTEM_2021_MAIN_TIMETYPE_HPP
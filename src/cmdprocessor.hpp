@@ -7,56 +7,82 @@
 
 #include "../lib/mytools.hpp"
 #include "../lib/timetype.hpp"
-#include "../lib/bst.hpp"
 #include <algorithm>
 
 namespace Sirius {
     constexpr int Argc_Max = 24, CmdTypeNum_Max = 16;
     constexpr int UserID_Max = 21, Password_Max = 31, Name_Max = 16, MailAddr_Max = 31, UserNum_Max = 5000321; //Username = UserID
     constexpr int TrainID_Max = 21, StationNum_Max = 101, StationName_Max = 31;
-    constexpr int Pool_Max = 10005;
 
-    typedef FixedStr<UserID_Max> uidType;
+    typedef HashedStr<UserID_Max> uidType;
     typedef FixedStr<Password_Max> pwdType;
     typedef FixedStr<Name_Max> uNameType;
     typedef FixedStr<MailAddr_Max> addrType;
-    typedef FixedStr<TrainID_Max> tidType;
-    typedef FixedStr<StationName_Max> staNameType;
+    typedef HashedStr<TrainID_Max> tidType;
+    typedef HashedStr<StationName_Max> staNameType;
 
     const tidType TrainIDStr_Max = "~~~~~~~~~~~~~~~~~~~~";
 
-    const std::string CMD[CmdTypeNum_Max] = {"add_user", "login", "logout", "query_profile", "modify_profile", "add_train",
-                                            "release_train", "query_train", "delete_train", "query_ticket", "query_transfer",
-                                            "buy_ticket", "query_order", "refund_ticket", "clean", "exit"
-                                            };
+    constexpr const char* CMD[CmdTypeNum_Max] = {"add_user", "login", "logout", "query_profile", "modify_profile", "add_train",
+                                                 "release_train", "query_train", "delete_train", "query_ticket", "query_transfer",
+                                                 "buy_ticket", "query_order", "refund_ticket", "clean", "exit"
+                                                 };
+
+    /* 命令名的完美哈希：(长度 + 首字符 + 31*末字符) mod 32，16 个命令名两两不同槽，命中后再比一次串 */
+    constexpr int CmdSlot_Num = 32;
+    constexpr int cmdSlot(const char* name, int len) {
+        return (len + name[0] + 31 * name[len-1]) & (CmdSlot_Num-1);
+    }
+    constexpr int constLength(const char* str) {
+        int len = 0;
+        while (str[len]) ++len;
+        return len;
+    }
+    struct CmdTable { //槽位 -> 命令编号，-1 为空
+        int cmdNo[CmdSlot_Num];
+        bool perfect;
+        constexpr CmdTable():cmdNo(), perfect(true) {
+            for (int i = 0; i < CmdSlot_Num; ++i) cmdNo[i] = -1;
+            for (int i = 0; i < CmdTypeNum_Max; ++i) {
+                int slot = cmdSlot(CMD[i], constLength(CMD[i]));
+                if (cmdNo[slot] != -1) perfect = false;
+                cmdNo[slot] = i;
+            }
+        }
+    };
+    constexpr CmdTable CmdLookup;
+    static_assert(CmdLookup.perfect, "command names collide in cmdSlot");
 
     struct cmdType {
         int cmdNo, argNum;
-        std::string args[26];
+        StrRef args[26]; //指向输入行，各参数后面的空格已改成 '\0'，str 可以直接当 C 串用
         cmdType() : cmdNo(0), argNum(0), args() {}
     };
 
-    //翻译命令字符串，以及简单的合法性检查
-    std::pair<cmdType, bool> parse(const std::string& cmdStr) {
-        cmdType ret;
-        int argc = 0, len = cmdStr.size();
-        bool valid = false;
-        std::string argv[Argc_Max];
-        while (cmdStr[len-1] == ' ' || cmdStr[len-1] == '\r' || cmdStr[len-1] == '\n') --len; //过滤尾部无用字符
-        split(cmdStr.substr(0, len), argv, argc, ' ');
-        for (int i = 0; i < CmdTypeNum_Max; ++i) { //找到对应函数的编号
-            if (argv[0] == CMD[i]) {
-                ret.cmdNo = i; ret.argNum = ((argc-1)>>1);
-                valid = true;
-                break;
-            }
+    //原地切分命令行（把分隔的空格改成 '\0'）并做简单的合法性检查，不分配内存
+    bool parse(char* cmdStr, cmdType& ret) {
+        int len = strlen(cmdStr), argc = 0;
+        while (len && (cmdStr[len-1] == ' ' || cmdStr[len-1] == '\r' || cmdStr[len-1] == '\n')) --len; //过滤尾部无用字符
+        StrRef argv[Argc_Max];
+        for (int i = 0, j; i < len; i = j) {
+            while (i < len && cmdStr[i] == ' ') ++i;
+            if (i == len) break;
+            if (argc == Argc_Max) return false;
+            for (j = i; j < len && cmdStr[j] != ' '; ++j);
+            cmdStr[j] = '\0', argv[argc++] = StrRef(cmdStr + i, j - i);
+            if (j < len) ++j;
         }
-        if (!(argc & 1)) valid = false;
-        for (int i = 1; i < argc; i += 2) { //从字符串中记录参数
-            if (argv[i][0] != '-' || argv[i].size() != 2 || argv[i][1] < 'a' || argv[i][1] > 'z') valid = false;
+        if (!(argc & 1)) return false;
+        int cmdNo = CmdLookup.cmdNo[cmdSlot(argv[0].str, argv[0].len)];
+        if (cmdNo == -1 || argv[0] != CMD[cmdNo]) return false;
+        ret.cmdNo = cmdNo, ret.argNum = argc >> 1;
+        for (int i = 0; i < 26; ++i) ret.args[i] = StrRef();
+        bool valid = true;
+        for (int i = 1; i < argc; i += 2) { //记录参数
+            if (argv[i][0] != '-' || argv[i].len != 2 || argv[i][1] < 'a' || argv[i][1] > 'z') valid = false;
             else ret.args[int(argv[i][1]-'a')] = argv[i+1];
         }
-        return std::make_pair(ret, valid);
+        return valid;
     }
 }
 
@@ -1,14 +1,67 @@
 //TicketSystem main.cpp for test
 
 #include "systemcore.hpp"
+#include "pipeline.hpp"
+#include "readbatch.hpp"
+#include "../lib/linereader.hpp"
+#include <fcntl.h>
 
 Sirius::System ticketSystem;
-char buffer[7005];
 
-int main() {
+//参数：[--pipeline | --parallel] [--arena-stats] [命令文件]，不给文件就读 stdin
+//--pipeline 让读入、执行、写出各占一个线程；--parallel 把连续的只读查询攒成批并行执行，query_transfer 也分给多个线程扫
+//不加 --parallel 就不开线程池；--arena-stats 在退出前往 stderr 报告单条命令临时区用到的最大字节数
+void run(bool pipelined, bool parallel, int fd) {
+    if (pipelined) {
+        Sirius::Pipeline(ticketSystem, fd).run();
+        return;
+    }
+    if (parallel) {
+        ticketSystem.setThreads(std::thread::hardware_concurrency());
+        Sirius::ReadBatch batch(ticketSystem);
+        Sirius::LineReader reader(fd, [&]{batch.run(), Sirius::output.flush();}); //等输入前先把攒着的查询做完、输出交出去
+        while (true) {
+            char* line = reader.nextLine();
+            if (!line) break;
+            int len = strlen(line);
+            Sirius::cmdType cmd;
+            if (!Sirius::parse(line, cmd)) break;
+            if (ticketSystem.readOnly(cmd)) {
+                batch.add(line, len, cmd);
+                continue;
+            }
+            batch.run();
+            if (!ticketSystem.execute(cmd)) break;
+            if (Sirius::output.size() >= Sirius::OutBuffer::Flush_Size) Sirius::output.flush();
+        }
+        batch.run();
+        Sirius::output.flush();
+        return;
+    }
+    Sirius::LineReader reader(fd, []{Sirius::output.flush();}); //等输入前把攒着的输出交出去
     while (true) {
-        memset(buffer, 0, sizeof(buffer));
-        fgets(buffer, 7000, stdin);
-        if (!ticketSystem.response(buffer)) return 0;
+        char* line = reader.nextLine();
+        if (!line || !ticketSystem.response(line)) break;
+        if (Sirius::output.size() >= Sirius::OutBuffer::Flush_Size) Sirius::output.flush();
+    }
+    Sirius::output.flush();
+}
+
+int main(int argc, char* argv[]) {
+    bool pipelined = false, parallel = false, arenaStats = false;
+    const char* file = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--pipeline")) pipelined = true;
+        else if (!strcmp(argv[i], "--parallel")) parallel = true;
+        else if (!strcmp(argv[i], "--arena-stats")) arenaStats = true;
+        else file = argv[i];
+    }
+    int fd = 0;
+    if (file && (fd = open(file, O_RDONLY)) == -1) {
+        perror(file);
+        return 1;
     }
-}
\ No newline at end of file
+    run(pipelined, parallel, fd);
+    if (arenaStats) fprintf(stderr, "arena high-water mark: %zu bytes\n", ticketSystem.scratchHighWater());
+    return 0;
+}
@@ -0,0 +1,111 @@
+//
+// Created by SiriusNEO.
+//
+
+#ifndef TICKETSYSTEM_2021_MAIN_PIPELINE_HPP
+#define TICKETSYSTEM_2021_MAIN_PIPELINE_HPP
+
+#include "systemcore.hpp"
+#include "../lib/linereader.hpp"
+#include "../lib/spscring.hpp"
+#include <thread>
+
+namespace Sirius {
+    /* 流水线模式：读入线程（读 + 切分命令）-> 执行线程（调用者，System::execute）-> 写出线程（write 系统调用）
+     * 读入线程把命令行复制进一批（Batch）的文本区再原地切分，攒够一批交给执行线程；执行线程的输出攒满 Flush_Size 就整块换给写出线程
+     * 批和输出缓冲区都是预先开好的几块，用两对 SPSC 队列来回传（满的过去、空的回来），顺序天然保持
+     * 读入线程每次要 read 之前把手里的半批交出去并标记 flushAfter，执行线程做完这批就交出输出，交互时不会憋着不回
+     * 输入在 EOF、exit、解析失败处结束，和单线程一样：解析失败的那行不执行、不输出
+     */
+    class Pipeline {
+    private:
+        static constexpr int Batch_Num = 8, Batch_Cmd = 256, Batch_Text = 1 << 16, Out_Num = 4;
+        static constexpr int Exit_Cmd = CmdTypeNum_Max - 1; //CMD 最后一个是 exit
+        struct Batch {
+            char* text; //本批命令行的副本，cmds 里的 StrRef 指向这里
+            int len, cap, cnt;
+            bool stop, flushAfter; //stop：输入到此为止；flushAfter：读入线程要去等输入了
+            cmdType cmds[Batch_Cmd];
+        };
+        System& system;
+        int fd;
+        Batch batches[Batch_Num];
+        OutBuffer outs[Out_Num];
+        SpscRing<Batch*, Batch_Num> ready, freeBatch;
+        SpscRing<OutBuffer*, Out_Num> filled, freeOut; //filled 里的 nullptr 让写出线程退出
+
+        static void reset(Batch* batch) {batch->len = batch->cnt = 0, batch->stop = batch->flushAfter = false;}
+
+        void readLoop() {
+            Batch* batch = freeBatch.pop();
+            bool waiting = true; //最后交出去的一批是否已带 flushAfter
+            auto handOver = [&](bool flushAfter) {
+                batch->flushAfter = flushAfter, waiting = flushAfter;
+                ready.push(batch);
+                batch = freeBatch.pop();
+            };
+            LineReader reader(fd, [&]{if (batch->cnt || !waiting) handOver(true);});
+            while (true) {
+                char* line = reader.nextLine();
+                if (!line) break;
+                int len = strlen(line);
+                if (batch->cnt == Batch_Cmd || batch->len + len + 1 > batch->cap) {
+                    if (batch->cnt) handOver(false);
+                    if (len + 1 > batch->cap) { //空批，文本区还没被引用，直接换大的
+                        delete[] batch->text;
+                        while (len + 1 > batch->cap) batch->cap <<= 1;
+                        batch->text = new char[batch->cap];
+                    }
+                }
+                char* text = batch->text + batch->len;
+                memcpy(text, line, len + 1), batch->len += len + 1;
+                cmdType& cmd = batch->cmds[batch->cnt];
+                if (!parse(text, cmd)) break;
+                ++batch->cnt;
+                if (cmd.cmdNo == Exit_Cmd) break;
+            }
+            batch->stop = batch->flushAfter = true;
+            ready.push(batch);
+        }
+
+        void writeLoop() {
+            while (OutBuffer* out = filled.pop()) out->flush(), freeOut.push(out);
+        }
+
+        void handOutput() {
+            OutBuffer* out = freeOut.pop();
+            output.swap(*out);
+            filled.push(out);
+        }
+
+    public:
+        Pipeline(System& _system, int _fd):system(_system), fd(_fd) {
+            for (int i = 0; i < Batch_Num; ++i) {
+                batches[i].text = new char[Batch_Text], batches[i].cap = Batch_Text;
+                reset(batches + i), freeBatch.push(batches + i);
+            }
+            for (int i = 0; i < Out_Num; ++i) freeOut.push(outs + i);
+        }
+        ~Pipeline() {
+            for (int i = 0; i < Batch_Num; ++i) delete[] batches[i].text;
+        }
+
+        void run() {
+            output.flush();
+            std::thread reader(&Pipeline::readLoop, this), writer(&Pipeline::writeLoop, this);
+            while (true) {
+                Batch* batch = ready.pop();
+                bool quit = false;
+                for (int i = 0; i < batch->cnt && !quit; ++i) quit = !system.execute(batch->cmds[i]);
+                bool stop = quit || batch->stop;
+                if (stop || batch->flushAfter || output.size() >= OutBuffer::Flush_Size) handOutput();
+                reset(batch), freeBatch.push(batch);
+                if (stop) break;
+            }
+            reader.join();
+            filled.push(nullptr), writer.join();
+        }
+    };
+}
+
+#endif //TICKETSYSTEM_2021_MAIN_PIPELINE_HPP
@@ -0,0 +1,51 @@
+//
+// Created by SiriusNEO.
+//
+
+#ifndef TICKETSYSTEM_2021_MAIN_READBATCH_HPP
+#define TICKETSYSTEM_2021_MAIN_READBATCH_HPP
+
+#include "systemcore.hpp"
+
+namespace Sirius {
+    /* 并行模式下攒连续的只读命令：命令行复制进批的文本区（切分出的 StrRef 跟着挪过去），遇到修改类命令、要等输入或读完时整批交给 System::executeReadOnly
+     * 修改类命令相当于屏障：先把前面攒的只读命令做完、输出，再执行它
+     */
+    class ReadBatch {
+    private:
+        static constexpr int Batch_Cmd = 1024, Batch_Text = 1 << 18;
+        System& system;
+        char* text;
+        int len, cap, cnt;
+        cmdType cmds[Batch_Cmd];
+
+    public:
+        explicit ReadBatch(System& _system):system(_system), text(new char[Batch_Text]), len(0), cap(Batch_Text), cnt(0) {}
+        ~ReadBatch() {delete[] text;}
+
+        //line 已被 parse 原地切分成 cmd，lineLen 是切分前的长度
+        void add(const char* line, int lineLen, const cmdType& cmd) {
+            if (cnt == Batch_Cmd || len + lineLen + 1 > cap) {
+                run();
+                if (lineLen + 1 > cap) { //批是空的，文本区没有被引用，直接换大的
+                    delete[] text;
+                    while (lineLen + 1 > cap) cap <<= 1;
+                    text = new char[cap];
+                }
+            }
+            char* copy = text + len;
+            memcpy(copy, line, lineLen + 1), len += lineLen + 1;
+            cmds[cnt] = cmd;
+            for (auto& arg : cmds[cnt].args)
+                if (arg.len) arg.str = copy + (arg.str - line);
+            ++cnt;
+        }
+        void run() {
+            if (!cnt) return;
+            system.executeReadOnly(cmds, cnt);
+            len = cnt = 0;
+        }
+    };
+}
+
+#endif //TICKETSYSTEM_2021_MAIN_READBATCH_HPP
@@ -0,0 +1,85 @@
+//
+// Created by SiriusNEO.
+//
+
+#ifndef TICKETSYSTEM_2021_MAIN_RESULTCACHE_HPP
+#define TICKETSYSTEM_2021_MAIN_RESULTCACHE_HPP
+
+#include "cmdprocessor.hpp"
+#include "../lib/lrucache.hpp"
+
+namespace Sirius {
+    /* 只读查询的结果缓存：规范化后的命令 -> 返回值和输出的原始字节
+     * 每条结果记下执行时读过的 (车次, 天) 以及当时它们的版本号；改座位、发布/增删车次时对应版本号加一
+     * 版本号放在定长数组里，按 (车次, 天) 哈希取槽，两个键撞在一个槽上只会多作废，不会读到旧结果
+     * 依赖“有哪些车次”的查询（query_ticket / query_transfer）还要记 release 的纪元，任何 release 都让它们作废
+     */
+    class ResultCache {
+    public:
+        static constexpr int TrainTag = -1; //车次本身（存在与否、是否 release），不是哪一天的座位
+
+    private:
+        static constexpr int Cache_Size = 512, Version_Slot = 1 << 16;
+        struct Entry {
+            std::string key, out;
+            int result, epoch; //epoch == -1：不依赖 release 纪元
+            Vector<int> slots;
+            Vector<unsigned> versions;
+        };
+        LRUCache<Entry, Cache_Size> entries;
+        unsigned versions[Version_Slot];
+        int epoch;
+        Entry* recording; //正在执行、要记下读集合的那条
+        int outMark; //它的输出从 output 的这个位置开始
+
+        bool hit(const Entry* entry, const std::string& key, int& result) const {
+            if (!entry || entry->key != key || (entry->epoch != -1 && entry->epoch != epoch)) return false;
+            for (int i = 0; i < entry->slots.size(); ++i)
+                if (versions[entry->slots[i]] != entry->versions[i]) return false;
+            write(entry->out.data(), entry->out.size());
+            result = entry->result;
+            return true;
+        }
+        static int slotOf(hashCode tidHash, int day) {
+            hashCode x = tidHash ^ ((hashCode)(day + 2) * 0x9E3779B97F4A7C15ull);
+            x ^= x >> 29, x *= 0xBF58476D1CE4E5B9ull, x ^= x >> 32;
+            return x & (Version_Slot - 1);
+        }
+
+    public:
+        ResultCache():versions(), epoch(0), recording(nullptr), outMark(0) {}
+
+        //命中就把缓存的字节写出去并返回 true
+        bool lookup(const std::string& key, int& result) {return hit(entries.find(hash(key.c_str())), key, result);}
+        //同 lookup，但不调整 LRU 顺序，多个线程可以同时调（期间不能有 begin / bump）
+        bool peek(const std::string& key, int& result) {return hit(entries.peek(hash(key.c_str())), key, result);}
+        //开始执行一条未命中的查询：之后的输出和 noteRead 都记到它名下
+        void begin(const std::string& key, bool dependsOnRelease) {
+            recording = entries.insert(hash(key.c_str()));
+            recording->key = key, recording->out.clear();
+            recording->epoch = dependsOnRelease ? epoch : -1;
+            recording->slots.clear(), recording->versions.clear();
+            outMark = output.size();
+        }
+        void end(int result) {
+            recording->result = result;
+            recording->out.assign(output.data() + outMark, output.size() - outMark);
+            recording = nullptr;
+        }
+
+        void noteRead(hashCode tidHash, int day) {
+            if (!recording) return;
+            int slot = slotOf(tidHash, day);
+            recording->slots.push_back(slot), recording->versions.push_back(versions[slot]);
+        }
+        void bump(hashCode tidHash, int day) {++versions[slotOf(tidHash, day)];}
+        void bumpRelease() {++epoch;}
+
+        void clear() {
+            entries.clear();
+            ++epoch;
+        }
+    };
+}
+
+#endif //TICKETSYSTEM_2021_MAIN_RESULTCACHE_HPP
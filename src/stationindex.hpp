@@ -0,0 +1,167 @@
+//
+// Created by SiriusNEO.
+//
+
+#ifndef TICKETSYSTEM_2021_MAIN_STATIONINDEX_HPP
+#define TICKETSYSTEM_2021_MAIN_STATIONINDEX_HPP
+
+#include "cmdprocessor.hpp"
+#include <unistd.h>
+
+namespace Sirius {
+    /* 内存中的 站 -> 车次 邻接表
+     * 站名、车次各自编成从 0 开始的连续编号，每个站一个按 tidHash（车次在 trainDatabase 里的键）排好序的 Stop 数组
+     * 每个车次再存一份沿途站序列 route，从某个 Stop 往后就是这趟车能到的站（带到达时间、票价前缀和）
+     * 站名 <-> 站编号、车次 <-> 车次编号 两本字典也给订单用：订单只存编号，输出时才解码成字符串
+     * release_train 时增量插入，并立刻把这趟车（车次信息 + 沿途站名、时刻、票价）追加进文件，启动时按顺序重放
+     * 和 B+ 树一样在修改时写文件，不等析构；写到一半的最后一条重放时丢掉并截掉
+     */
+    class StationIndex {
+    public:
+        struct TrainInfo { //车次公共信息，Stop 里只存编号
+            tidType trainID;
+            hashCode tidHash, order; //order：旧版 polyHash，query_transfer 平局时按它定先后
+            TimeType startSaleDate, endSaleDate;
+        };
+        struct Stop { //某车次停靠某站
+            hashCode tidHash;
+            int trainNo, index, priceSum;
+            TimeType arrivingTime, leavingTime;
+        };
+        struct RouteStop { //车次沿途的一站
+            int station, priceSum;
+            TimeType arrivingTime, leavingTime;
+        };
+
+    private:
+        char fileName[25];
+        FILE* journal; //追加写的 release 记录
+        struct SavedStop { //记录里的一站：用站名而不是站编号，重放时重新编号
+            staNameType name;
+            int priceSum;
+            TimeType arrivingTime, leavingTime;
+        };
+        Vector<staNameType> names; //站编号 -> 站名（自带 hash）
+        Vector<Vector<Stop>> stops; //站编号 -> 经过它的车次
+        Vector<Vector<hashCode>> stopKeys; //和 stops 一一对应的 tidHash，连续存放给求交用，不落盘
+        Vector<TrainInfo> trains; //车次编号 -> 车次
+        Vector<Vector<RouteStop>> routes; //车次编号 -> 沿途各站
+        Vector<int> slot; //开放寻址：站名 -> 站编号+1，0 为空；hash 相同还要比站名
+        Vector<int> trainSlot; //开放寻址：tidHash -> 车次编号+1，0 为空（tidHash 是车次键，互不相同）
+
+        int probe(const staNameType& name) const {
+            int mask = slot.size() - 1, p = name.code & mask;
+            while (slot[p] && names[slot[p]-1] != name) p = (p + 1) & mask;
+            return p;
+        }
+        void rehash(int cap) {
+            slot.resize(cap);
+            for (int i = 0; i < cap; ++i) slot[i] = 0;
+            for (int i = 0; i < names.size(); ++i) slot[probe(names[i])] = i + 1;
+        }
+        int probeTrain(hashCode tidHash) const {
+            int mask = trainSlot.size() - 1, p = tidHash & mask;
+            while (trainSlot[p] && trains[trainSlot[p]-1].tidHash != tidHash) p = (p + 1) & mask;
+            return p;
+        }
+        void rehashTrains(int cap) {
+            trainSlot.resize(cap);
+            for (int i = 0; i < cap; ++i) trainSlot[i] = 0;
+            for (int i = 0; i < trains.size(); ++i) trainSlot[probeTrain(trains[i].tidHash)] = i + 1;
+        }
+        int intern(const staNameType& name) {
+            int p = probe(name);
+            if (slot[p]) return slot[p] - 1;
+            names.push_back(name), stops.push_back(Vector<Stop>()), stopKeys.push_back(Vector<hashCode>());
+            slot[p] = names.size();
+            if (names.size() * 2 > slot.size()) rehash(slot.size() << 1);
+            return names.size() - 1;
+        }
+
+        void load() { //重放记录，之后以追加方式打开
+            FILE* f = fopen(fileName, "rb");
+            if (f) {
+                long good = 0; //最后一条完整记录的结尾
+                TrainInfo info;
+                SavedStop route[StationNum_Max];
+                int num;
+                while (fread(&info, sizeof(TrainInfo), 1, f) == 1 && fread(&num, sizeof(int), 1, f) == 1
+                       && num >= 0 && num <= StationNum_Max && (int)fread(route, sizeof(SavedStop), num, f) == num) {
+                    int trainNo = addTrain(info.trainID, info.tidHash, info.startSaleDate, info.endSaleDate);
+                    for (int i = 0; i < num; ++i)
+                        addStop(route[i].name, (Stop){info.tidHash, trainNo, i, route[i].priceSum, route[i].arrivingTime, route[i].leavingTime});
+                    good = ftell(f);
+                }
+                fclose(f);
+                if (truncate(fileName, good)) perror(fileName);
+            }
+            journal = fopen(fileName, "ab");
+        }
+
+    public:
+        explicit StationIndex(const char* _fileName) {
+            strcpy(fileName, _fileName);
+            rehash(16), rehashTrains(16);
+            load();
+        }
+        ~StationIndex() {fclose(journal);}
+
+        //登记一个车次，返回车次编号
+        int addTrain(const tidType& trainID, hashCode tidHash, const TimeType& startSaleDate, const TimeType& endSaleDate) {
+            trains.push_back((TrainInfo){trainID, tidHash, polyHash(trainID.str), startSaleDate, endSaleDate});
+            routes.push_back(Vector<RouteStop>());
+            trainSlot[probeTrain(tidHash)] = trains.size();
+            if (trains.size() * 2 > trainSlot.size()) rehashTrains(trainSlot.size() << 1);
+            return trains.size() - 1;
+        }
+        //按沿途顺序调用：接到车次的 route 后面，并在站 name 的表里按 tidHash 有序插入，同车次重复的站只留第一个（返回 false）
+        bool addStop(const staNameType& name, const Stop& stop) {
+            int station = intern(name);
+            routes[stop.trainNo].push_back((RouteStop){station, stop.priceSum, stop.arrivingTime, stop.leavingTime});
+            auto& list = stops[station];
+            int l = 0, r = list.size();
+            while (l < r) {
+                int mid = (l + r) >> 1;
+                if (list[mid].tidHash < stop.tidHash) l = mid + 1;
+                else r = mid;
+            }
+            if (l < list.size() && list[l].tidHash == stop.tidHash) return false;
+            list.insert(l, stop), stopKeys[station].insert(l, stop.tidHash);
+            return true;
+        }
+
+        //车次的站都 addStop 完后调用：把它追加进文件并 flush
+        void saveTrain(int trainNo) {
+            const auto& route = routes[trainNo];
+            int num = route.size();
+            SavedStop saved[StationNum_Max];
+            for (int i = 0; i < num; ++i)
+                saved[i] = (SavedStop){names[route[i].station], route[i].priceSum, route[i].arrivingTime, route[i].leavingTime};
+            fwrite(&trains[trainNo], sizeof(TrainInfo), 1, journal), fwrite(&num, sizeof(int), 1, journal);
+            fwrite(saved, sizeof(SavedStop), num, journal);
+            fflush(journal);
+        }
+
+        int find(const staNameType& name) const { //站编号，没有这个站返回 -1
+            int p = probe(name);
+            return slot[p] ? slot[p] - 1 : -1;
+        }
+        const Vector<Stop>& stopsOf(int station) const {return stops[station];}
+        const Vector<hashCode>& keysOf(int station) const {return stopKeys[station];}
+        int trainNoOf(hashCode tidHash) const { //车次编号，没有 release 过返回 -1
+            return trainSlot[probeTrain(tidHash)] - 1;
+        }
+        const TrainInfo& train(int trainNo) const {return trains[trainNo];}
+        const Vector<RouteStop>& routeOf(int trainNo) const {return routes[trainNo];}
+        int stationNum() const {return names.size();}
+        const staNameType& name(int station) const {return names[station];}
+
+        void clear() {
+            names.clear(), stops.clear(), stopKeys.clear(), trains.clear(), routes.clear();
+            rehash(16), rehashTrains(16);
+            fclose(journal), journal = fopen(fileName, "wb");
+        }
+    };
+}
+
+#endif //TICKETSYSTEM_2021_MAIN_STATIONINDEX_HPP
@@ -6,7 +6,18 @@
 #define TICKETSYSTEM_2021_MAIN_SYSTEMCORE_HPP
 
 #include "cmdprocessor.hpp"
+#include "stationindex.hpp"
+#include "resultcache.hpp"
 #include "../db/bpt.hpp"
+#include "../db/olc_bpt.hpp"
+#include "../db/seat_matrix.hpp"
+#include "../lib/seatops.hpp"
+#include "../lib/sessiontable.hpp"
+#include "../lib/threadpool.hpp"
+#include "../lib/lrucache.hpp"
+#include "../lib/intersect.hpp"
+#include "../lib/arena.hpp"
+#include <atomic>
 
 namespace Sirius {
     enum orderStatusType {SUCCESS, PENDING, REFUNDED};
@@ -16,13 +27,45 @@ namespace Sirius {
     public:
         /*  User  */
         struct User {
+            uidType userID; //按 hash 找到记录后还要比对 userID，两个 uid 撞 hash 时不会认错人
             pwdType password;
             uNameType name;
             addrType mailAddr;
             int privilege;
         };
-        Bptree<hashCode, User> userDatabase; //uid -> user
-        Sirius::BinarySearchTree<hashCode> loggedUser;
+        /* 用户键：从 userID 的 hash 起线性探测，跳过 userID 不同的记录，第一个空位就是新用户的键
+         * 用户不会被单独删除，探测链不会断
+         */
+        Bptree<hashCode, User> userDatabase; //用户键 -> user
+        struct Session {
+            hashCode key; //在 userDatabase 里的键
+            User user;
+        };
+        SessionTable<Session> loggedUser; //已登录的 uid hash -> 会话，modify_profile 时同步更新
+        static auto sameUser(const uidType& uid) {
+            return [&uid](const Session& session) {return session.user.userID == uid;};
+        }
+        Session* findSession(const uidType& uid) { //未登录返回 nullptr
+            return loggedUser.find(uid.code, sameUser(uid));
+        }
+        int loggedPrivilege(const uidType& uid) { //未登录返回 -1
+            auto session = findSession(uid);
+            return session ? session->user.privilege : -1;
+        }
+        struct UserRef {
+            User user;
+            hashCode key; //找不到时是可以插入的空位
+            bool found;
+        };
+        UserRef findUser(const uidType& uid) { //已登录的用户不用查 userDatabase
+            auto session = findSession(uid);
+            if (session) return (UserRef){session->user, session->key, true};
+            for (hashCode key = uid.code; ; ++key) {
+                auto user = userDatabase.find(key);
+                if (!user.second) return (UserRef){User(), key, false};
+                if (user.first.userID == uid) return (UserRef){user.first, key, true};
+            }
+        }
 
         /* Train
          * 0 -> 1 -> 2 -> 3 -> ... -> n
@@ -32,172 +75,400 @@ namespace Sirius {
          * arrive[0] === 0, leaving[0] = startTime, leaving[final] === Int_Max，保证起点不做终点站，终点不做起点站
         */
         struct Train {
-            bool isReleased;
+            bool isReleased; //必须在最前：release_train 用 modify_info(.., 0) 直接改它
             tidType trainID;
             int stationNum;
             staNameType stations[StationNum_Max]; //0-based
             int totalSeatNum, priceSum[StationNum_Max];
             TimeType startTime, arrivingTimes[StationNum_Max], leavingTimes[StationNum_Max], startSaleDate, endSaleDate;
             char type;
+
+            //变长存储：各数组只存 stationNum 项
+            int packedSize() const {
+                return sizeof(bool) + sizeof(tidType) + 2 * sizeof(int) + sizeof(char) + 3 * sizeof(TimeType)
+                       + stationNum * (sizeof(staNameType) + sizeof(int) + 2 * sizeof(TimeType));
+            }
+            void pack(char* p) const {
+                packItem(p, &isReleased), packItem(p, &trainID), packItem(p, &stationNum), packItem(p, &totalSeatNum);
+                packItem(p, &type), packItem(p, &startTime), packItem(p, &startSaleDate), packItem(p, &endSaleDate);
+                packItem(p, stations, stationNum), packItem(p, priceSum, stationNum);
+                packItem(p, arrivingTimes, stationNum), packItem(p, leavingTimes, stationNum);
+            }
+            void unpack(const char* p) {
+                unpackItem(p, &isReleased), unpackItem(p, &trainID), unpackItem(p, &stationNum), unpackItem(p, &totalSeatNum);
+                unpackItem(p, &type), unpackItem(p, &startTime), unpackItem(p, &startSaleDate), unpackItem(p, &endSaleDate);
+                unpackItem(p, stations, stationNum), unpackItem(p, priceSum, stationNum);
+                unpackItem(p, arrivingTimes, stationNum), unpackItem(p, leavingTimes, stationNum);
+            }
         };
-        Bptree<hashCode, Train> trainDatabase; //tid -> train
+        /* 车次键：和用户键一样从 trainID 的 hash 起线性探测
+         * delete_train 时如果下一个键上还有车次（可能是撞 hash 探测过来的），原位留一个 trainID 为空的墓碑，不让探测链断掉
+         */
+        Bptree<hashCode, Train> trainDatabase; //车次键 -> train
+
+        static constexpr int Train_Cache_Size = 256, Station_Slot = 256; //Station_Slot 是 2 的幂且不小于 2*StationNum_Max
+        struct CachedTrain { //解码好的 Train，外加 站名 -> 站下标 的表，查 -f/-t 不用逐站 strcmp
+            Train train;
+            unsigned char slot[Station_Slot]; //按站名自带的 hash 取槽，存站下标+1，0 为空；同名站只记第一个
+            int probe(const staNameType& name) const {
+                int p = name.code & (Station_Slot-1);
+                while (slot[p] && train.stations[slot[p]-1] != name) p = (p + 1) & (Station_Slot-1);
+                return p;
+            }
+            void build() {
+                memset(slot, 0, sizeof(slot));
+                for (int i = 0; i < train.stationNum; ++i) {
+                    int p = probe(train.stations[i]);
+                    if (!slot[p]) slot[p] = i + 1;
+                }
+            }
+            int indexOf(const staNameType& name) const { //无此站返回 -1
+                return slot[probe(name)] - 1;
+            }
+        };
+        LRUCache<CachedTrain, Train_Cache_Size> trainCache; //车次键 -> 最近用过的 Train，release/delete 时作废
+        CachedTrain* getTrain(hashCode idHash) { //按车次键取，这个键上没有记录返回 nullptr
+            resultCache.noteRead(idHash, ResultCache::TrainTag);
+            auto ret = readCtx ? trainCache.peek(idHash) : trainCache.find(idHash);
+            if (ret) return ret;
+            auto train = trainDatabase.find(idHash);
+            if (!train.second) return nullptr;
+            ret = readCtx ? &readCtx->train : trainCache.insert(idHash); //并行时不动共享的缓存，读到线程自己那份里
+            ret->train = train.first, ret->build();
+            return ret;
+        }
+        struct TrainRef {
+            CachedTrain* cached; //无此车为 nullptr
+            hashCode key; //找不到时是可以插入的空位
+        };
+        TrainRef findTrain(const tidType& id) {
+            for (hashCode key = id.code; ; ++key) {
+                auto cached = getTrain(key);
+                if (!cached || cached->train.trainID == id) return (TrainRef){cached, key};
+            }
+        }
+
+        SeatMatrix<hashCode> seatMatrix; //车次键 -> 整个售卖期的座位矩阵
+        ResultCache resultCache; //只读查询的结果，按 (车次, 天) 版本号作废
 
-        struct DayTrain { //某一天发站的 trainID 火车上的座位情况. 优化：线段树
+        struct DayTrain { //某一天发站的 trainID 火车上的座位情况（座位矩阵中的一行）
+            hashCode tidHash;
+            SeatMatrix<hashCode>::block_info block;
+            int day;
             int seatNum[StationNum_Max];
-            int querySeat(int l, int r) {
-                int ret = Int_Max;
-                for (int i = l; i <= r; ++i) ret = std::min(ret, seatNum[i]);
-                return ret;
+            int querySeat(int l, int r) { //闭区间，向量化扫描
+                return rangeMin(seatNum, l, r);
             }
             void modifySeat(int l, int r, int val) {
-                for (int i = l; i <= r; ++i) seatNum[i] += val;
+                rangeAdd(seatNum, l, r, val);
             }
         };
-        Bptree<std::pair<TimeType, hashCode>, DayTrain> dayTrainDatabase; //(startDay, tid) -> dayTrain
+        DayTrain getDayTrain(hashCode idHash, const TimeType& startDay) {
+            resultCache.noteRead(idHash, startDay.getDayNum());
+            DayTrain ret;
+            ret.tidHash = idHash, ret.block = seatMatrix.find(idHash).first, ret.day = startDay.getDayNum();
+            if (ret.block.offset != -1) seatMatrix.read_row(ret.block, ret.day, ret.seatNum);
+            return ret;
+        }
+        void putDayTrain(DayTrain& dayTrain) {
+            seatMatrix.write_row(dayTrain.tidHash, dayTrain.block, dayTrain.day, dayTrain.seatNum);
+            resultCache.bump(dayTrain.tidHash, dayTrain.day);
+        }
 
-        struct Station { //属于某个车次的站
-            tidType trainID;
-            staNameType station;
-            hashCode tidHash;
-            int index, priceSum; //方便查座位用
-            TimeType startSaleDate, endSaleDate, arrivingTime, leavingTime; //精简版信息，不用去查 trainDatabase
-            Station() = default;
+        typedef StationIndex::Stop Stop;
+        typedef StationIndex::TrainInfo TrainInfo;
+        StationIndex stationIndex; //staName -> 经过它的所有车次（已 release）
+
+        /* (s, t) 线路的物化视图：查过的站对缓存所有从 s 开到 t 的车次，票价差、历时都预先算好
+         * release_train 时给已有的视图增量追加；按查询 LRU 淘汰，没缓存的站对查询时现场求交再建
+         */
+        struct RouteEntry {
+            int trainNo, from, to, cost, time;
+            TimeType leavingTime, arrivingTime; //from 站发车、to 站到达（相对发站日）
         };
-        Bptree<std::pair<hashCode, hashCode>, Station> stationDatabase; //(staName, tid) -> 特定车次的 station
+        static constexpr int Route_View_Size = 1024;
+        LRUCache<Vector<RouteEntry>, Route_View_Size> routeViews; //(sId, tId) -> 视图
+        static hashCode routeKey(int sId, int tId) {return (hashCode)sId << 32 | (unsigned)tId;}
 
         struct Ticket {
-            Station s, t;
+            const TrainInfo* train;
+            RouteEntry e;
             Ticket() = default;
-            Ticket(const Station& _s, const Station& _t):s(_s), t(_t){}
+            Ticket(const TrainInfo* _train, const RouteEntry& _e):train(_train), e(_e){}
             inline int time() const {
-                return t.arrivingTime - s.leavingTime;
+                return e.time;
             }
             inline int cost() const {
-                return t.priceSum - s.priceSum;
+                return e.cost;
             }
         };
-        static bool timeCmp(const Ticket& obj1, const Ticket& obj2) {
-            return (obj1.time() == obj2.time()) ? obj1.s.trainID < obj2.s.trainID : obj1.time() < obj2.time();
+        /* query_ticket 的排序：按 (time 或 cost, trainID)
+         * 每张票先算成整数键 (primary, prefix)，prefix 是 trainID 前 8 字节按大端拼成的整数，比较结果和 strcmp 一致
+         * 票多时对整数键做 LSD 基数排序，否则 introsort；最后把两个键都相同（trainID 前 8 字节相同）的段按完整 trainID 修正
+         */
+        struct TicketKey {
+            unsigned long long primary, prefix;
+            int pos; //在 tickets 中的下标
+        };
+        static bool ticketKeyCmp(const TicketKey& obj1, const TicketKey& obj2) {
+            return obj1.primary != obj2.primary ? obj1.primary < obj2.primary : obj1.prefix < obj2.prefix;
+        }
+        static constexpr int Radix_Min = 256;
+        struct HubEntry { //query_transfer 的 hash join：第 tPos 个到 t 的车次在它第 l 站上车，nxt 串起同一换乘站
+            int tPos, l, nxt;
+        };
+        Vector<int> hubHead; //站编号 -> 链头，查询之间保持全 -1
+        Vector<HubEntry> hubEntries;
+        struct TransferQuery { //一次 query_transfer 的只读上下文，各线程共享
+            const Vector<Stop> *sList, *tList;
+            TimeType day;
+            bool byCost;
+            int minRide2, minCost2; //第二程的乘车时间、票价下界
+        };
+        struct TransferBest {
+            int ans = Int_Max, firstTime = Int_Max, sPos = -1, tPos = -1, k = 0, l = 0, hub = 0;
+            int sTrain = -1, tTrain = -1; //两程的车次编号
+            TimeType startDay1, startDay2;
+        };
+        bool trainBefore(int trainNo1, int trainNo2) const { //平局时车次的先后：旧版 polyHash，再按编号
+            hashCode order1 = stationIndex.train(trainNo1).order, order2 = stationIndex.train(trainNo2).order;
+            return order1 != order2 ? order1 < order2 : trainNo1 < trainNo2;
         }
-        static bool costCmp(const Ticket& obj1, const Ticket& obj2) {
-            return (obj1.cost() == obj2.cost()) ? obj1.s.trainID < obj2.s.trainID : obj1.cost() < obj2.cost();
+        //同 (ans, firstTime) 时依次按 第一程车次、第二程车次、换乘站名 取最靠前的，与线程怎么分块无关
+        bool transferBetter(const TransferBest& obj1, const TransferBest& obj2) const {
+            if (obj1.ans != obj2.ans) return obj1.ans < obj2.ans;
+            if (obj1.firstTime != obj2.firstTime) return obj1.firstTime < obj2.firstTime;
+            if (obj1.sTrain != obj2.sTrain) return trainBefore(obj1.sTrain, obj2.sTrain);
+            if (obj1.tTrain != obj2.tTrain) return trainBefore(obj1.tTrain, obj2.tTrain);
+            return stationIndex.name(obj1.hub) < stationIndex.name(obj2.hub);
+        }
+        static constexpr int Transfer_Parallel_Min = 64, Transfer_Chunk = 8; //出发车次不少于这么多才分给线程池，每次抢一块
+        int threads = 1; //允许用的线程数（含自己），默认 1：不开线程池，全部串行
+        ThreadPool* pool = nullptr; //第一次要并行时才建
+        ThreadPool& threadPool() {
+            if (!pool) pool = new ThreadPool(threads);
+            return *pool;
         }
-        typedef std::pair<staNameType, int> stationPair;
-        static bool stationCmp(const stationPair& obj1, const stationPair& obj2) {return obj1.first < obj2.first;}
 
         /* Order */
+        /* 订单只存编号：车次名、站名、发到时刻、票价都能由 (trainNo, fromIndex, toIndex) 在 stationIndex 里查到，输出时才解码
+         * 能买票的车一定 release 过，有车次编号；用户已经在键里
+         */
         struct Order {
-            orderStatusType status;
-            tidType trainID;
-            uidType userID;
-            int fromIndex, toIndex;
-            staNameType from, to;
-            TimeType startDay, leavingTime, arrivingTime;
-            int orderID, price, num;
+            orderStatusType status; //必须在最前：modify_info(.., 0) 直接改它
+            int trainNo, fromIndex, toIndex;
+            TimeType startDay;
+            int orderID, num;
         };
         struct PendingOrder {
-            hashCode tidHash, uidHash;
+            hashCode uidHash;
             int fromIndex, toIndex, orderID, num;
+        };
+        /* 候补一单一条：(startDay, 车次键, fromIndex, toIndex, orderID)，候补只插一条、退掉只删一条，不用整队读出来改了再写回
+         * 同一车次同一天的候补连续，里面按区间分桶：退票空出 [F, T) 这些段时，只有 fromIndex < T 且 toIndex > F 的订单可能补上
+         * 同一 (fromIndex, toIndex) 的一段按 orderID 递增，也就是先来后到
+         */
+        struct WaitKey {
             TimeType startDay;
+            hashCode tidHash;
+            int fromIndex, toIndex, orderID;
+            bool operator < (const WaitKey& obj) const {
+                if (!(startDay == obj.startDay)) return startDay < obj.startDay;
+                if (tidHash != obj.tidHash) return tidHash < obj.tidHash;
+                if (fromIndex != obj.fromIndex) return fromIndex < obj.fromIndex;
+                if (toIndex != obj.toIndex) return toIndex < obj.toIndex;
+                return orderID < obj.orderID;
+            }
+            bool operator <= (const WaitKey& obj) const {return !(obj < *this);}
+            bool operator >= (const WaitKey& obj) const {return !(*this < obj);}
         };
-        Bptree<std::pair<hashCode, int>, Order> orderDatabase; // (uid, oid) -> order
-        Bptree<std::pair<std::pair<TimeType, hashCode>, int>, PendingOrder> pendingQueue;// (startDay, tid, oid) -> order
+        OlcBptree<std::pair<hashCode, int>, Order> orderDatabase; // (用户键, oid) -> order，定长小记录，并行的 query_order 不用互相等
+        Bptree<WaitKey, PendingOrder> waitlistDatabase;// 候补订单
 
         int (System::*Interfaces[CmdTypeNum_Max])(const cmdType&) = {&System::add_user, &System::login, &System::logout, &System::query_profile, &System::modify_profile,
                                                                      &System::add_train, &System::release_train, &System::query_train, &System::delete_train, &System::query_ticket,
                                                                      &System::query_transfer, &System::buy_ticket, &System::query_order, &System::refund_ticket, &System::clean,
                                                                      &System::exit
         };
-        Station sList[Pool_Max], tList[Pool_Max];
-        Ticket tickets[Pool_Max];
-        Order orders[Pool_Max];
-        PendingOrder refundOrders[Pool_Max];
+        Arena scratch; //每条命令的临时数组（车票、排序键、求交下标、订单列表），response 开头整体收回
+
+        /* 并行执行一批只读命令（query_profile / query_train / query_ticket / query_order）
+         * 批内没有修改，状态是一致的；各线程有自己的临时区和输出缓冲区，按命令记下输出在哪个缓冲区的哪一段，最后按原顺序拼回 output
+         * LRU 缓存（车次、线路视图、结果缓存）只 peek 不调整也不插入，没命中就现读到线程自己的 ReadContext 里；B+ 树和座位文件的读各自加锁
+         * 所以同一棵 Bptree（用户、车次、座位索引）上的读还是串行的，真正并行的是缓存命中的部分、订单查询（OlcBptree）和算票、输出
+         */
+        struct ReadContext {
+            Arena scratch;
+            OutBuffer out;
+            CachedTrain train;
+            Vector<RouteEntry> view;
+        };
+        struct ReadSpan { //第 i 条命令的输出：第 worker 个线程缓冲区的 [begin, end)
+            int worker, begin, end;
+        };
+        static constexpr int Read_Parallel_Min = 4; //少于这么多条就不分给线程池
+        ReadContext* readContexts = nullptr; //每个线程一份，第一次并行执行只读批时才开
+        static thread_local ReadContext* readCtx; //当前线程在并行批里时指向它的 ReadContext，否则为 nullptr
+        Arena& tempArena() {return readCtx ? readCtx->scratch : scratch;}
 
     public:
-        System():userDatabase("user.bin", "user1.bin"), loggedUser(),trainDatabase("train.bin", "train1.bin"), dayTrainDatabase("daytrain.bin", "daytrain1.bin"),
-                 stationDatabase("station.bin", "station1.bin"), orderDatabase("order.bin", "order1.bin"), pendingQueue("queue.bin", "queue1.bin"){}
+        System():userDatabase("user.bin", "user1.bin"), loggedUser(),trainDatabase("train.bin", "train1.bin"), seatMatrix("seat.bin", "seatindex.bin", "seatindex1.bin"),
+                 stationIndex("stationindex.bin"), orderDatabase("order.bin"), waitlistDatabase("queue.bin", "queue1.bin"){}
+        ~System() {delete pool, delete[] readContexts;}
+
+        size_t scratchHighWater() const { //各临时区单条命令用到的最大字节数，--arena-stats 时退出前报告
+            size_t ret = scratch.highWaterMark();
+            if (readContexts)
+                for (int i = 0; i < pool->size(); ++i) ret = std::max(ret, readContexts[i].scratch.highWaterMark());
+            return ret;
+        }
+
+        //并行模式打开：只读批和 query_transfer 最多用 n 个线程；线程池和各线程的上下文都等到真要并行时才建
+        void setThreads(int n) {threads = std::max(n, 1);}
+
+        //可缓存查询的规范化键（参数顺序无关，-p 只区分 cost 与否），其它命令返回空串
+        std::string queryKey(const cmdType& info) const {
+            auto handler = Interfaces[info.cmdNo];
+            if (handler == &System::query_train && info.argNum == 2)
+                return "train|" + info.args['i'-'a'].toString() + "|" + info.args['d'-'a'].toString();
+            if ((handler == &System::query_ticket || handler == &System::query_transfer) && info.argNum >= 3 && info.argNum <= 4)
+                return std::string(handler == &System::query_ticket ? "ticket|" : "transfer|") + info.args['s'-'a'].toString() + "|" + info.args['t'-'a'].toString()
+                       + "|" + info.args['d'-'a'].toString() + (info.argNum == 4 && info.args['p'-'a'] == "cost" ? "|cost" : "|time");
+            return "";
+        }
 
-        bool response(const std::string &cmdStr) { // false::quit
-            auto info = parse(cmdStr);
-            if (info.second) {
-                int result = (this->* Interfaces[info.first.cmdNo])(info.first);
-                if (result == 0 || result == -1) printf("%d", result);
-                putchar('\n');
-                return result != 2;
+        bool response(char* cmdStr) { // false::quit；cmdStr 会被原地切分
+            cmdType info;
+            return parse(cmdStr, info) && execute(info);
+        }
+
+        bool execute(const cmdType& info) { //已切分好的命令，false::quit；流水线模式下解析在别的线程做
+            scratch.reset();
+            return dispatch(info) != 2;
+        }
+
+        int dispatch(const cmdType& info) { //执行并写出结果行，返回 handler 的返回值
+            int result;
+            auto handler = Interfaces[info.cmdNo];
+            std::string key = queryKey(info);
+            if (key.empty()) result = (this->* handler)(info);
+            else if (readCtx) { //并行批里只查不记
+                if (!resultCache.peek(key, result)) result = (this->* handler)(info);
+            }
+            else if (!resultCache.lookup(key, result)) { //未命中：执行并记下输出和读到的 (车次, 天)
+                resultCache.begin(key, handler != &System::query_train);
+                result = (this->* handler)(info);
+                resultCache.end(result);
             }
-            return false;
+            if (result == 0 || result == -1) writeInt(result);
+            writeChar('\n');
+            return result;
+        }
+
+        bool readOnly(const cmdType& info) const { //可以和相邻的只读命令并行执行
+            auto handler = Interfaces[info.cmdNo];
+            return handler == &System::query_profile || handler == &System::query_train || handler == &System::query_ticket || handler == &System::query_order;
+        }
+
+        void executeReadOnly(const cmdType* cmds, int n) { //cmds 全是 readOnly 的，输出和逐条执行一致
+            if (n < Read_Parallel_Min || threads == 1) {
+                for (int i = 0; i < n; ++i) execute(cmds[i]);
+                return;
+            }
+            scratch.reset();
+            ReadSpan* spans = scratch.alloc<ReadSpan>(n);
+            std::atomic<int> cursor(0);
+            ThreadPool& pool = threadPool();
+            if (!readContexts) readContexts = new ReadContext[pool.size()];
+            pool.run([&](int id) {
+                ReadContext& ctx = readContexts[id];
+                readCtx = &ctx, curOutput = &ctx.out;
+                for (int i; (i = cursor.fetch_add(1, std::memory_order_relaxed)) < n; ) {
+                    ctx.scratch.reset();
+                    int begin = ctx.out.size();
+                    dispatch(cmds[i]);
+                    spans[i] = (ReadSpan){id, begin, ctx.out.size()};
+                }
+                readCtx = nullptr, curOutput = &output;
+            });
+            for (int i = 0; i < n; ++i) output.put(readContexts[spans[i].worker].out.data() + spans[i].begin, spans[i].end - spans[i].begin);
+            for (int i = 0; i < pool.size(); ++i) readContexts[i].out.clear();
         }
 
         int add_user(const cmdType& info) {
             if (info.argNum != 6) return -1;
-            hashCode uidHash = hash(info.args['u'-'a'].c_str());
+            uidType uid = info.args['u'-'a'];
             if (userDatabase.size()) { //非第一次添加用户
-                int curUserPriv = loggedUser.find(hash(info.args['c'-'a'].c_str()));
+                int curUserPriv = loggedPrivilege(info.args['c'-'a']);
                 if (curUserPriv == -1) return -1; //-c未登录
                 int g = stringToInt(info.args['g'-'a']);
                 if (curUserPriv <= g) return -1; //-g权限大等于-c
-                if (userDatabase.find(uidHash).second) return -1; //id已有
-                userDatabase.insert(uidHash, (User){info.args['p'-'a'], info.args['n'-'a'], info.args['m'-'a'], g});
+                auto targetUser = findUser(uid);
+                if (targetUser.found) return -1; //id已有
+                userDatabase.insert(targetUser.key, (User){uid, info.args['p'-'a'], info.args['n'-'a'], info.args['m'-'a'], g});
                 return 0;
             }
             //创建第一个用户，直接插入，权限为10
-            userDatabase.insert(uidHash, (User){info.args['p'-'a'], info.args['n'-'a'], info.args['m'-'a'], 10});
+            userDatabase.insert(uid.code, (User){uid, info.args['p'-'a'], info.args['n'-'a'], info.args['m'-'a'], 10});
             return 0;
         }
 
         int login(const cmdType& info) {
             if (info.argNum != 2) return -1;
-            hashCode uidHash = hash(info.args['u'-'a'].c_str());
-            auto targetUser = userDatabase.find(uidHash);
-            if (!targetUser.second || loggedUser.find(uidHash) != -1) return -1; //无此用户、重复登陆
-            if (targetUser.first.password != pwdType(info.args['p'-'a'])) return -1; //密码错误
-            loggedUser.insert(uidHash, targetUser.first.privilege);
+            uidType uid = info.args['u'-'a'];
+            if (findSession(uid)) return -1; //重复登陆
+            auto targetUser = findUser(uid);
+            if (!targetUser.found) return -1; //无此用户
+            if (targetUser.user.password != pwdType(info.args['p'-'a'])) return -1; //密码错误
+            loggedUser.insert(uid.code, (Session){targetUser.key, targetUser.user});
             return 0;
         }
 
         int logout(const cmdType& info) {
             if (info.argNum != 1) return -1;
-            hashCode uidHash = hash(info.args['u'-'a'].c_str());
-            if (loggedUser.find(uidHash) == -1) return -1; //未登录
-            loggedUser.del(uidHash);
+            uidType uid = info.args['u'-'a'];
+            if (!findSession(uid)) return -1; //未登录
+            loggedUser.erase(uid.code, sameUser(uid));
             return 0;
         }
 
         int query_profile(const cmdType& info) {
             if (info.argNum != 2) return -1;
-            int curUserPriv = loggedUser.find(hash(info.args['c'-'a'].c_str()));
+            int curUserPriv = loggedPrivilege(info.args['c'-'a']);
             if (curUserPriv == -1) return -1; //-c未登录
-            auto targetUser = userDatabase.find(hash(info.args['u'-'a'].c_str()));
-            if (!targetUser.second) return -1; //-u 无此用户
-            if (curUserPriv <= targetUser.first.privilege && info.args['c'-'a'] != info.args['u'-'a']) return -1;
+            auto targetUser = findUser(info.args['u'-'a']);
+            if (!targetUser.found) return -1; //-u 无此用户
+            if (curUserPriv <= targetUser.user.privilege && info.args['c'-'a'] != info.args['u'-'a']) return -1;
             //-c权限小等于-u权限，且-c和-u不同
-            write(info.args['u'-'a'].c_str());putchar(' ');
-            write(targetUser.first.name.str);putchar(' ');
-            write(targetUser.first.mailAddr.str);putchar(' ');
-            writeInt(targetUser.first.privilege);
+            write(info.args['u'-'a']);writeChar(' ');
+            write(targetUser.user.name);writeChar(' ');
+            write(targetUser.user.mailAddr);writeChar(' ');
+            writeInt(targetUser.user.privilege);
             return 1;
         }
 
         int modify_profile(const cmdType& info) {
             if (info.argNum < 2 || info.argNum > 6) return -1;
-            int curUserPriv = loggedUser.find(hash(info.args['c'-'a'].c_str()));
+            int curUserPriv = loggedPrivilege(info.args['c'-'a']);
             if (curUserPriv == -1) return -1; //-c 未登录
-            hashCode uidHash = hash(info.args['u'-'a'].c_str());
-            auto targetUser = userDatabase.find(uidHash);
-            if (!targetUser.second) return -1; //-u 无此用户
-            if (curUserPriv <= targetUser.first.privilege && info.args['c'-'a'] != info.args['u'-'a']) return -1; //权限大等于或是同名，取反变成与
+            uidType uid = info.args['u'-'a'];
+            auto targetUser = findUser(uid);
+            if (!targetUser.found) return -1; //-u 无此用户
+            if (curUserPriv <= targetUser.user.privilege && info.args['c'-'a'] != info.args['u'-'a']) return -1; //权限大等于或是同名，取反变成与
             if (stringToInt(info.args['g'-'a']) >= curUserPriv) return -1; //-g 低于 -c
 
-            auto oldPassword = (info.args['p'-'a'].empty()) ? targetUser.first.password : info.args['p'-'a'];
-            auto oldName = (info.args['n'-'a'].empty()) ? targetUser.first.name : info.args['n'-'a'];
-            auto oldMailAddr = (info.args['m'-'a'].empty()) ? targetUser.first.mailAddr : info.args['m'-'a'];
-            auto oldPrivilege = (info.args['g'-'a'].empty()) ? targetUser.first.privilege : stringToInt(info.args['g'-'a']);
-
-            if (!info.args['g'-'a'].empty() && loggedUser.find(uidHash) != -1) loggedUser.insert(uidHash, oldPrivilege); //修改权限
-            userDatabase.modify(uidHash, (User){oldPassword, oldName, oldMailAddr, oldPrivilege});
-            write(info.args['u'-'a'].c_str());putchar(' ');
-            write(oldName.str);putchar(' ');
-            write(oldMailAddr.str);putchar(' ');
+            auto oldPassword = (info.args['p'-'a'].empty()) ? targetUser.user.password : info.args['p'-'a'];
+            auto oldName = (info.args['n'-'a'].empty()) ? targetUser.user.name : info.args['n'-'a'];
+            auto oldMailAddr = (info.args['m'-'a'].empty()) ? targetUser.user.mailAddr : info.args['m'-'a'];
+            auto oldPrivilege = (info.args['g'-'a'].empty()) ? targetUser.user.privilege : stringToInt(info.args['g'-'a']);
+
+            User newUser = (User){uid, oldPassword, oldName, oldMailAddr, oldPrivilege};
+            auto session = findSession(uid);
+            if (session) session->user = newUser; //已登录的缓存记录一起改
+            userDatabase.modify(targetUser.key, newUser);
+            write(info.args['u'-'a']);writeChar(' ');
+            write(oldName);writeChar(' ');
+            write(oldMailAddr);writeChar(' ');
             writeInt(oldPrivilege);
             return 1;
         }
@@ -205,20 +476,21 @@ namespace Sirius {
         int add_train(const cmdType& info) {
             if (info.argNum != 10) return -1;
             tidType id = info.args['i'-'a'];
-            hashCode idHash = hash(id.str);
-            if (trainDatabase.find(idHash).second) return -1; //tid已有
+            auto target = findTrain(id);
+            if (target.cached) return -1; //tid已有
+            hashCode idHash = target.key;
 
             Train newTrain = (Train){false, id, stringToInt(info.args['n'-'a'])};
             newTrain.totalSeatNum = stringToInt(info.args['m'-'a']);
             int tempStorageNum = 0;
-            std::string tempStorage1[StationNum_Max], tempStorage2[StationNum_Max];
+            StrRef tempStorage1[StationNum_Max], tempStorage2[StationNum_Max];
             split(info.args['s'-'a'], tempStorage1, tempStorageNum, '|');
             for (int i = 0; i < tempStorageNum; ++i) newTrain.stations[i] = tempStorage1[i];
             split(info.args['p'-'a'], tempStorage1, tempStorageNum, '|');
             for (int i = 1; i <= tempStorageNum; ++i)
                 newTrain.priceSum[i] = stringToInt(tempStorage1[i-1]) + newTrain.priceSum[i-1];
 
-            newTrain.startTime = "01-01 " + info.args['x'-'a'];
+            newTrain.startTime = TimeType::fromClock(info.args['x'-'a']);
             split(info.args['o'-'a'], tempStorage2, tempStorageNum, '|'); //stopoverTime
             split(info.args['t'-'a'], tempStorage1, tempStorageNum, '|'); //travelTime
             for (int i = 0; i < newTrain.stationNum; ++i) {
@@ -230,65 +502,82 @@ namespace Sirius {
                 else newTrain.leavingTimes[i] = Int_Max; //终点站leavingTime无穷
             }
             split(info.args['d'-'a'], tempStorage1, tempStorageNum, '|');
-            newTrain.startSaleDate = tempStorage1[0] + " 00:00", newTrain.endSaleDate = tempStorage1[1] + " 00:00";
+            newTrain.startSaleDate = TimeType::fromDate(tempStorage1[0]), newTrain.endSaleDate = TimeType::fromDate(tempStorage1[1]);
             newTrain.type = info.args['y'-'a'][0];
             trainDatabase.insert(idHash, newTrain);
+            resultCache.bump(idHash, ResultCache::TrainTag);
             return 0;
         }
 
         int release_train(const cmdType& info) {
             if (info.argNum != 1) return -1;
             tidType id = info.args['i'-'a'];
-            hashCode idHash = hash(id.str);
-            auto targetTrain = trainDatabase.find(idHash);
-            if (!targetTrain.second || targetTrain.first.isReleased) return -1; //找不到或已released
-            for (auto i = targetTrain.first.startSaleDate; i <= targetTrain.first.endSaleDate; i += 24*60) {
-                DayTrain dayTrain{};
-                for (int j = 0; j < targetTrain.first.stationNum; ++j) dayTrain.seatNum[j] = targetTrain.first.totalSeatNum;
-                dayTrainDatabase.insert(std::make_pair(i, idHash), dayTrain);
-            }
-            for (int i = 0; i < targetTrain.first.stationNum; ++i) {
-                stationDatabase.insert(std::make_pair(hash(targetTrain.first.stations[i].str), idHash),
-                                       (Station){id, targetTrain.first.stations[i], idHash, i, targetTrain.first.priceSum[i], targetTrain.first.startSaleDate, targetTrain.first.endSaleDate, targetTrain.first.arrivingTimes[i], targetTrain.first.leavingTimes[i]});
-            }
-            targetTrain.first.isReleased = true;
+            auto target = findTrain(id);
+            auto cached = target.cached;
+            hashCode idHash = target.key;
+            if (!cached || cached->train.isReleased) return -1; //找不到或已released
+            const Train& targetTrain = cached->train;
+            if (!seatMatrix.allocate(idHash, targetTrain.startSaleDate.getDayNum(),
+                                     (targetTrain.endSaleDate - targetTrain.startSaleDate) / (24*60) + 1,
+                                     targetTrain.stationNum - 1, targetTrain.totalSeatNum)) return -1; //售卖期超出座位矩阵能记的天数
+            int trainNo = stationIndex.addTrain(id, idHash, targetTrain.startSaleDate, targetTrain.endSaleDate), firstNum = 0;
+            int firstStop[StationNum_Max]; //每个站名第一次出现的位置，和 stationIndex 里记的一致
+            for (int i = 0; i < targetTrain.stationNum; ++i) {
+                if (stationIndex.addStop(targetTrain.stations[i],
+                                         (Stop){idHash, trainNo, i, targetTrain.priceSum[i], targetTrain.arrivingTimes[i], targetTrain.leavingTimes[i]}))
+                    firstStop[firstNum++] = i;
+            }
+            stationIndex.saveTrain(trainNo); //和 B+ 树一样当场落盘
+            const auto& route = stationIndex.routeOf(trainNo);
+            for (int a = 0; a < firstNum; ++a)
+                for (int b = a + 1; b < firstNum; ++b) {
+                    int i = firstStop[a], j = firstStop[b];
+                    auto view = routeViews.peek(routeKey(route[i].station, route[j].station));
+                    if (view) view->push_back((RouteEntry){trainNo, i, j, route[j].priceSum - route[i].priceSum,
+                                                           route[j].arrivingTime - route[i].leavingTime, route[i].leavingTime, route[j].arrivingTime});
+                }
             trainDatabase.modify_info(idHash, true, 0);
+            trainCache.erase(idHash);
+            resultCache.bump(idHash, ResultCache::TrainTag), resultCache.bumpRelease();
             return 0;
         }
 
         int query_train(const cmdType& info) {
             if (info.argNum != 2) return -1;
             tidType id = info.args['i'-'a'];
-            hashCode idHash = hash(id.str);
-            auto targetTrain = trainDatabase.find(idHash);
-            TimeType day(info.args['d'-'a'] + " 00:00");
-
-            if (!targetTrain.second) return -1; //无此车
-            if (!(targetTrain.first.startSaleDate <= day && day <= targetTrain.first.endSaleDate)) return -1; //这里的day是发车时间
-            const auto& dayTrain = dayTrainDatabase.find(std::make_pair(day, idHash));
-            write(targetTrain.first.trainID.str);putchar(' ');putchar(targetTrain.first.type);putchar('\n');
-            for (int i = 0; i < targetTrain.first.stationNum; ++i) {
-                write(targetTrain.first.stations[i].str);putchar(' ');
+            auto target = findTrain(id);
+            auto cached = target.cached;
+            hashCode idHash = target.key;
+            TimeType day = TimeType::fromDate(info.args['d'-'a']);
+
+            if (!cached) return -1; //无此车
+            const Train& targetTrain = cached->train;
+            if (!(targetTrain.startSaleDate <= day && day <= targetTrain.endSaleDate)) return -1; //这里的day是发车时间
+            DayTrain dayTrain;
+            if (targetTrain.isReleased) dayTrain = getDayTrain(idHash, day);
+            write(targetTrain.trainID);writeChar(' ');writeChar(targetTrain.type);writeChar('\n');
+            for (int i = 0; i < targetTrain.stationNum; ++i) {
+                write(targetTrain.stations[i]);writeChar(' ');
                 if (i == 0) {
                     write("xx-xx xx:xx -> ");
-                    write((day+targetTrain.first.leavingTimes[0]).toFormatString().c_str());
-                    putchar(' '), putchar('0'), putchar(' ');
-                    if (!targetTrain.first.isReleased) writeInt(targetTrain.first.totalSeatNum), putchar('\n');
-                    else writeInt(dayTrain.first.seatNum[0]), putchar('\n');
+                    writeTime(day+targetTrain.leavingTimes[0]);
+                    writeChar(' '), writeChar('0'), writeChar(' ');
+                    if (!targetTrain.isReleased) writeInt(targetTrain.totalSeatNum), writeChar('\n');
+                    else writeInt(dayTrain.seatNum[0]), writeChar('\n');
                 }
-                else if (i == targetTrain.first.stationNum-1){
-                    write((day+targetTrain.first.arrivingTimes[i]).toFormatString().c_str());
+                else if (i == targetTrain.stationNum-1){
+                    writeTime(day+targetTrain.arrivingTimes[i]);
                     write(" -> xx-xx xx:xx ");
-                    writeInt(targetTrain.first.priceSum[i]);
-                    putchar(' '), putchar('x');
+                    writeInt(targetTrain.priceSum[i]);
+                    writeChar(' '), writeChar('x');
                 }
                 else {
-                    write((day+targetTrain.first.arrivingTimes[i]).toFormatString().c_str());
+                    writeTime(day+targetTrain.arrivingTimes[i]);
                     write(" -> ");
-                    write((day+targetTrain.first.leavingTimes[i]).toFormatString().c_str());putchar(' ');
-                    writeInt(targetTrain.first.priceSum[i]);putchar(' ');
-                    if (!targetTrain.first.isReleased) writeInt(targetTrain.first.totalSeatNum), putchar('\n');
-                    else writeInt(dayTrain.first.seatNum[i]), putchar('\n');
+                    writeTime(day+targetTrain.leavingTimes[i]);writeChar(' ');
+                    writeInt(targetTrain.priceSum[i]);writeChar(' ');
+                    if (!targetTrain.isReleased) writeInt(targetTrain.totalSeatNum), writeChar('\n');
+                    else writeInt(dayTrain.seatNum[i]), writeChar('\n');
                 }
             }
             return 1;
@@ -297,191 +586,233 @@ namespace Sirius {
         int delete_train(const cmdType& info) {
             if (info.argNum != 1) return -1;
             tidType id = info.args['i'-'a'];
-            hashCode idHash = hash(id.str);
-            auto targetTrain = trainDatabase.find(idHash);
-            if (!targetTrain.second || targetTrain.first.isReleased) return -1; //无此车或已发行
-            trainDatabase.erase(idHash);
+            auto target = findTrain(id);
+            hashCode idHash = target.key;
+            if (!target.cached || target.cached->train.isReleased) return -1; //无此车或已发行
+            if (getTrain(idHash + 1)) trainDatabase.modify(idHash, Train()); //留墓碑（trainID 为空，不会和任何车次相等）
+            else trainDatabase.erase(idHash);
+            trainCache.erase(idHash);
+            resultCache.bump(idHash, ResultCache::TrainTag);
             return 0;
         }
 
+        TicketKey* rankTickets(const Ticket* tickets, int ticketCnt, bool byCost) { //返回按输出顺序排好的键
+            TicketKey* ticketKeys = tempArena().alloc<TicketKey>(ticketCnt);
+            for (int i = 0; i < ticketCnt; ++i) {
+                int primary = byCost ? tickets[i].cost() : tickets[i].time();
+                unsigned long long prefix = tickets[i].train->trainID.orderWord(0);
+                ticketKeys[i] = (TicketKey){(unsigned)primary ^ 0x80000000u, prefix, i}; //翻转符号位，负数也保序
+            }
+            if (ticketCnt >= Radix_Min) {
+                TicketKey* ticketKeyBuf = tempArena().alloc<TicketKey>(ticketCnt);
+                radixSort(ticketKeys, ticketKeyBuf, ticketCnt, [](const TicketKey& key) {return key.prefix;});
+                radixSort(ticketKeys, ticketKeyBuf, ticketCnt, [](const TicketKey& key) {return key.primary;}, 32);
+            }
+            else introSort(ticketKeys, ticketKeys + ticketCnt, ticketKeyCmp);
+            auto idCmp = [&](const TicketKey& obj1, const TicketKey& obj2) {
+                return tickets[obj1.pos].train->trainID < tickets[obj2.pos].train->trainID;
+            };
+            for (int i = 0, j; i < ticketCnt; i = j) {
+                for (j = i + 1; j < ticketCnt && !ticketKeyCmp(ticketKeys[i], ticketKeys[j]); ++j);
+                if (j - i > 1) insertionSort(ticketKeys + i, ticketKeys + j, idCmp);
+            }
+            return ticketKeys;
+        }
+
+        const Vector<RouteEntry>& getRouteView(int sId, int tId) {
+            auto view = readCtx ? routeViews.peek(routeKey(sId, tId)) : routeViews.find(routeKey(sId, tId));
+            if (view) return *view;
+            view = readCtx ? &readCtx->view : routeViews.insert(routeKey(sId, tId));
+            view->clear();
+            const auto &sList = stationIndex.stopsOf(sId), &tList = stationIndex.stopsOf(tId);
+            const auto &sKeys = stationIndex.keysOf(sId), &tKeys = stationIndex.keysOf(tId);
+            int* joinS = tempArena().alloc<int>(std::min(sKeys.size(), tKeys.size())); //同一车次在 s 表、t 表中的下标
+            int* joinT = tempArena().alloc<int>(std::min(sKeys.size(), tKeys.size()));
+            int joinCnt = intersect(sKeys.begin(), sKeys.size(), tKeys.begin(), tKeys.size(), joinS, joinT);
+            for (int i = 0; i < joinCnt; ++i) {
+                const auto &si = sList[joinS[i]], &ti = tList[joinT[i]];
+                if (si.index < ti.index)
+                    view->push_back((RouteEntry){si.trainNo, si.index, ti.index, ti.priceSum - si.priceSum,
+                                                 ti.arrivingTime - si.leavingTime, si.leavingTime, ti.arrivingTime});
+            }
+            return *view;
+        }
+
         int query_ticket(const cmdType& info) {
             if (info.argNum < 3 || info.argNum > 4) return -1;
-            TimeType day = info.args['d'-'a'] + " 00:00";
+            TimeType day = TimeType::fromDate(info.args['d'-'a']);
             staNameType s = info.args['s'-'a'], t = info.args['t'-'a'];
-            hashCode sHash = hash(s.str), tHash = hash(t.str);
             if (s == t) return 0; //起终相同，直接判掉
-            int sLen = 0, tLen = 0;
-            stationDatabase.range_find(std::make_pair(sHash, 0), std::make_pair(sHash, LL_Max), sList, sLen);
-            stationDatabase.range_find(std::make_pair(tHash, 0), std::make_pair(tHash, LL_Max), tList, tLen);
-            if (!sLen || !tLen) return 0; //无票
-            auto si = sList, ti = tList;
+            int sId = stationIndex.find(s), tId = stationIndex.find(t);
+            if (sId == -1 || tId == -1) return 0; //无票
+            const auto& view = getRouteView(sId, tId);
+            Ticket* tickets = tempArena().alloc<Ticket>(view.size());
             int ticketCnt = 0;
-            while (si != sList+sLen && ti != tList+tLen) {
-                if (si->tidHash < ti->tidHash) si++;
-                else if (si->tidHash > ti->tidHash) ti++;
-                else if (si->index >= ti->index) si++, ti++;
-                else {
-                    TimeType startDay = day - si->leavingTime.getDate(); //要在day这一天上车，对应的发站时间
-                    if (si->startSaleDate <= startDay && startDay <= si->endSaleDate)
-                        //售卖时间范围内每天都有车.同一辆车，arr和lea可以直接比. 比两个更鲁棒
-                        tickets[ticketCnt++] = Ticket(*si, *ti);
-                    si++, ti++;
-                }
+            for (const auto& e : view) {
+                TimeType startDay = day - e.leavingTime.getDate(); //要在day这一天上车，对应的发站时间
+                const auto& train = stationIndex.train(e.trainNo);
+                if (train.startSaleDate <= startDay && startDay <= train.endSaleDate)
+                    //售卖时间范围内每天都有车.同一辆车，arr和lea可以直接比. 比两个更鲁棒
+                    tickets[ticketCnt++] = Ticket(&train, e);
             }
             if (!ticketCnt) return 0;
-            if (info.argNum == 4 && info.args['p'-'a'] == "cost") qsort(tickets, tickets+ticketCnt-1, costCmp);
-            else qsort(tickets, tickets+ticketCnt-1, timeCmp);
+            TicketKey* ticketKeys = rankTickets(tickets, ticketCnt, info.argNum == 4 && info.args['p'-'a'] == "cost");
             writeInt(ticketCnt);
             for (int i = 0; i < ticketCnt; ++i) {
-                hashCode idHash = hash(tickets[i].s.trainID.str);
-                TimeType startDay = day - tickets[i].s.leavingTime.getDate();
-                auto dayTrain = dayTrainDatabase.find(std::make_pair(startDay, idHash));
-                std::string lea = (startDay + tickets[i].s.leavingTime).toFormatString(),
-                        arr = (startDay + tickets[i].t.arrivingTime).toFormatString();
-                putchar('\n');
-                write(tickets[i].s.trainID.str);putchar(' ');
-                write(tickets[i].s.station.str);putchar(' ');
-                write(lea.c_str()), putchar(' '), putchar('-'), putchar('>'), putchar(' ');
-                write(tickets[i].t.station.str);putchar(' ');
-                write(arr.c_str()), putchar(' ');
-                writeInt(tickets[i].cost()), putchar(' ');
-                writeInt(dayTrain.first.querySeat(tickets[i].s.index, tickets[i].t.index-1));
+                const Ticket& ticket = tickets[ticketKeys[i].pos];
+                TimeType startDay = day - ticket.e.leavingTime.getDate();
+                auto dayTrain = getDayTrain(ticket.train->tidHash, startDay);
+                writeChar('\n');
+                write(ticket.train->trainID);writeChar(' ');
+                write(stationIndex.name(sId));writeChar(' ');
+                writeTime(startDay + ticket.e.leavingTime), writeChar(' '), writeChar('-'), writeChar('>'), writeChar(' ');
+                write(stationIndex.name(tId));writeChar(' ');
+                writeTime(startDay + ticket.e.arrivingTime), writeChar(' ');
+                writeInt(ticket.cost()), writeChar(' ');
+                writeInt(dayTrain.querySeat(ticket.e.from, ticket.e.to-1));
             }
             return 1;
         }
 
+        //probe：沿第 [from, to) 个出发车次的第一程往后走，在换乘站的链上找第二程，只读共享数据
+        void transferScan(const TransferQuery& query, int from, int to, TransferBest& best) const {
+            for (int i = from; i < to; ++i) {
+                const auto& si = (*query.sList)[i];
+                TimeType startDay1 = query.day - si.leavingTime.getDate();
+                const auto& infoS = stationIndex.train(si.trainNo);
+                if (!(infoS.startSaleDate <= startDay1 && startDay1 <= infoS.endSaleDate)) continue;
+                const auto& routeS = stationIndex.routeOf(si.trainNo);
+                for (int k = si.index + 1; k < routeS.size(); ++k) {
+                    int firstTime = routeS[k].arrivingTime - si.leavingTime, firstCost = routeS[k].priceSum - si.priceSum;
+                    if ((query.byCost ? firstCost + query.minCost2 : firstTime + query.minRide2) > best.ans) break; //越往后第一程越长越贵，下界已超过当前最优
+                    for (int e = hubHead[routeS[k].station]; e != -1; e = hubEntries[e].nxt) {
+                        const auto& ti = (*query.tList)[hubEntries[e].tPos];
+                        if (ti.trainNo == si.trainNo) continue;
+                        int l = hubEntries[e].l;
+                        const auto& routeT = stationIndex.routeOf(ti.trainNo);
+                        const auto& infoT = stationIndex.train(ti.trainNo);
+                        TimeType fastestStartDay2;
+                        if (routeS[k].arrivingTime.getClock() <= routeT[l].leavingTime.getClock())
+                            fastestStartDay2 = (startDay1 + routeS[k].arrivingTime).getDate() - routeT[l].leavingTime.getDate();
+                        else
+                            fastestStartDay2 = (startDay1 + routeS[k].arrivingTime).getDate() + 24 * 60 - routeT[l].leavingTime.getDate();
+                        //第一辆车发车时间，第二辆车最快发车时间（保证第二辆车 上车时间为第一辆车到达当天）
+                        if (infoT.endSaleDate < fastestStartDay2) continue; //最快还是赶不上第二辆车卖完，不行
+                        TransferBest cur;
+                        cur.startDay1 = startDay1;
+                        cur.startDay2 = std::max(fastestStartDay2, infoT.startSaleDate); //如果能最快发车就最快，否则从第二辆车第一次发车就上车
+                        cur.ans = query.byCost ? firstCost + ti.priceSum - routeT[l].priceSum
+                                               : (cur.startDay2 + ti.arrivingTime) - (startDay1 + si.leavingTime);
+                        cur.firstTime = firstTime, cur.sPos = i, cur.tPos = hubEntries[e].tPos;
+                        cur.sTrain = si.trainNo, cur.tTrain = ti.trainNo;
+                        cur.k = k, cur.l = l, cur.hub = routeS[k].station;
+                        if (transferBetter(cur, best)) best = cur;
+                    }
+                }
+            }
+        }
+
         int query_transfer(const cmdType& info) {
             if (info.argNum < 3 || info.argNum > 4) return -1;
-            TimeType day = info.args['d'-'a'] + " 00:00";
+            TimeType day = TimeType::fromDate(info.args['d'-'a']);
             staNameType s = info.args['s'-'a'], t = info.args['t'-'a'];
-            hashCode sHash = hash(s.str), tHash = hash(t.str);
             if (s == t) return 0;
-            int sLen = 0, tLen = 0;
-            stationDatabase.range_find(std::make_pair(sHash, 0), std::make_pair(sHash, LL_Max), sList, sLen);
-            stationDatabase.range_find(std::make_pair(tHash, 0), std::make_pair(tHash, LL_Max), tList, tLen);
-            if (!sLen || !tLen) return 0; //无票
-            int ans = Int_Max, firstTime = Int_Max;
-            std::string ret;
-            for (auto si = sList; si != sList+sLen; si++) {
-                TimeType startDay1 = day - si->leavingTime.getDate();
-                if (!(si->startSaleDate <= startDay1 && startDay1 <= si->endSaleDate)) continue;
-                auto trainS = trainDatabase.find(hash(si->trainID.str));
-                for (auto ti = tList; ti != tList+tLen; ti++) {
-                    if (ti->trainID == si->trainID) continue;
-                    auto trainT = trainDatabase.find(hash(ti->trainID.str));
-                    stationPair kList[StationNum_Max+2], lList[StationNum_Max+2];
-                    int kLen = 0, lLen = 0;
-                    for (int k = si->index + 1; k < trainS.first.stationNum; ++k) kList[kLen++] = std::make_pair(trainS.first.stations[k], k);
-                    for (int l = 0; l < ti->index; ++l) lList[lLen++] = std::make_pair(trainT.first.stations[l], l);
-                    if (!kLen || !lLen) continue;
-                    qsort(kList, kList+kLen-1, stationCmp);
-                    qsort(lList, lList+lLen-1, stationCmp);
-                    stationPair *ptr1 = kList, *ptr2 = lList;
-                    while (ptr1 != kList+kLen && ptr2 != lList+lLen) {
-                        if (ptr1->first < ptr2->first) ptr1++;
-                        else if (ptr1->first > ptr2->first) ptr2++;
-                        else {
-                            int k = ptr1->second, l = ptr2->second;
-                            ptr1++, ptr2++;
-                            TimeType fastestStartDay2;
-                            if (trainS.first.arrivingTimes[k].getClock() <=
-                                trainT.first.leavingTimes[l].getClock())
-                                fastestStartDay2 = (startDay1 + trainS.first.arrivingTimes[k]).getDate() -
-                                                   trainT.first.leavingTimes[l].getDate();
-                            else
-                                fastestStartDay2 =
-                                        (startDay1 + trainS.first.arrivingTimes[k]).getDate() + 24 * 60 -
-                                        trainT.first.leavingTimes[l].getDate();
-                            //第一辆车发车时间，第二辆车最快发车时间（保证第二辆车 上车时间为第一辆车到达当天）
-                            if (ti->endSaleDate < fastestStartDay2) continue; //最快还是赶不上第二辆车卖完，不行
-                            TimeType startDay2 = std::max(fastestStartDay2,
-                                                          ti->startSaleDate); //如果能最快发车就最快，否则从第二辆车第一次发车就上车
-                            bool updated = false;
-                            if (info.argNum == 4 && info.args['p' - 'a'] == "cost") {
-                                if ((ans > trainS.first.priceSum[k] - si->priceSum + ti->priceSum -
-                                           trainT.first.priceSum[l]) ||
-                                    (ans == trainS.first.priceSum[k] - si->priceSum + ti->priceSum -
-                                            trainT.first.priceSum[l] &&
-                                     firstTime > trainS.first.arrivingTimes[k] - si->leavingTime)) {
-                                    ans = trainS.first.priceSum[k] - si->priceSum + ti->priceSum -
-                                          trainT.first.priceSum[l];
-                                    firstTime = trainS.first.arrivingTimes[k] - si->leavingTime;
-                                    updated = true;
-                                }
-                            } else if (ans > (startDay2 + ti->arrivingTime) - (startDay1 + si->leavingTime) ||
-                                       (ans == (startDay2 + ti->arrivingTime) - (startDay1 + si->leavingTime) &&
-                                        firstTime > trainS.first.arrivingTimes[k] - si->leavingTime)) {
-                                ans = (startDay2 + ti->arrivingTime) - (startDay1 + si->leavingTime);
-                                firstTime = trainS.first.arrivingTimes[k] - si->leavingTime;
-                                updated = true;
-                            }
-                            if (updated) {
-                                ret.clear();
-                                auto dayTrainS = dayTrainDatabase.find(
-                                        std::make_pair(startDay1, hash(trainS.first.trainID.str)));
-                                auto dayTrainT = dayTrainDatabase.find(
-                                        std::make_pair(startDay2, hash(trainT.first.trainID.str)));
-                                ret += std::string(si->trainID.str) + " " +
-                                       std::string(trainS.first.stations[si->index].str) + " " +
-                                       (startDay1 + si->leavingTime).toFormatString()
-                                       + " -> " + std::string(trainS.first.stations[k].str) + " " +
-                                       (startDay1 + trainS.first.arrivingTimes[k]).toFormatString() + " " +
-                                       std::to_string(trainS.first.priceSum[k] - si->priceSum) + " " +
-                                       std::to_string(dayTrainS.first.querySeat(si->index, k - 1)) + "\n";
-                                ret += std::string(trainT.first.trainID.str) + " " +
-                                       std::string(trainT.first.stations[l].str) + " " +
-                                       (startDay2 + trainT.first.leavingTimes[l]).toFormatString()
-                                       + " -> " + std::string(trainT.first.stations[ti->index].str) + " " +
-                                       (startDay2 + ti->arrivingTime).toFormatString() + " " +
-                                       std::to_string(ti->priceSum - trainT.first.priceSum[l]) + " " +
-                                       std::to_string(dayTrainT.first.querySeat(l, ti->index - 1));
-                            }
-                        }
-                    }
+            int sId = stationIndex.find(s), tId = stationIndex.find(t);
+            if (sId == -1 || tId == -1) return 0; //无票
+            const auto &sList = stationIndex.stopsOf(sId), &tList = stationIndex.stopsOf(tId);
+            bool byCost = info.argNum == 4 && info.args['p'-'a'] == "cost";
+
+            //build：能开到 t 的每个 (车次, 上车站 l) 按上车站挂链，换乘站就是 hash join 的键
+            while (hubHead.size() < stationIndex.stationNum()) hubHead.push_back(-1);
+            hubEntries.clear();
+            int minRide2 = Int_Max, minCost2 = Int_Max; //第二程的乘车时间、票价下界
+            for (int j = 0; j < tList.size(); ++j) {
+                const auto& routeT = stationIndex.routeOf(tList[j].trainNo);
+                for (int l = 0; l < tList[j].index; ++l) {
+                    hubEntries.push_back((HubEntry){j, l, hubHead[routeT[l].station]});
+                    hubHead[routeT[l].station] = hubEntries.size() - 1;
+                    minRide2 = std::min(minRide2, tList[j].arrivingTime - routeT[l].leavingTime);
+                    minCost2 = std::min(minCost2, tList[j].priceSum - routeT[l].priceSum);
                 }
             }
-            if (ans != Int_Max) {
-                write(ret.c_str());
-                return 1;
+
+            TransferQuery query = {&sList, &tList, day, byCost, minRide2, minCost2};
+            TransferBest best;
+            if (!hubEntries.empty() && sList.size() >= Transfer_Parallel_Min && threads > 1) {
+                //出发车次分块给各线程，每个线程各自保留最优，最后归约
+                ThreadPool& pool = threadPool();
+                Vector<TransferBest> local;
+                local.resize(pool.size());
+                std::atomic<int> cursor(0);
+                pool.run([&](int id) {
+                    for (int from; (from = cursor.fetch_add(Transfer_Chunk)) < sList.size(); )
+                        transferScan(query, from, std::min(from + Transfer_Chunk, sList.size()), local[id]);
+                });
+                for (int id = 0; id < pool.size(); ++id)
+                    if (local[id].sPos != -1 && transferBetter(local[id], best)) best = local[id];
             }
-            return 0;
+            else if (!hubEntries.empty()) transferScan(query, 0, sList.size(), best);
+            for (int j = 0; j < tList.size(); ++j) { //把用过的链头复原
+                const auto& routeT = stationIndex.routeOf(tList[j].trainNo);
+                for (int l = 0; l < tList[j].index; ++l) hubHead[routeT[l].station] = -1;
+            }
+            if (best.ans == Int_Max) return 0;
+
+            const auto &si = sList[best.sPos], &ti = tList[best.tPos];
+            const auto &routeS = stationIndex.routeOf(si.trainNo), &routeT = stationIndex.routeOf(ti.trainNo);
+            int k = best.k, l = best.l;
+            auto dayTrainS = getDayTrain(si.tidHash, best.startDay1);
+            auto dayTrainT = getDayTrain(ti.tidHash, best.startDay2);
+            write(stationIndex.train(si.trainNo).trainID);writeChar(' ');
+            write(stationIndex.name(sId));writeChar(' ');
+            writeTime(best.startDay1 + si.leavingTime);write(" -> ");
+            write(stationIndex.name(routeS[k].station));writeChar(' ');
+            writeTime(best.startDay1 + routeS[k].arrivingTime);writeChar(' ');
+            writeInt(routeS[k].priceSum - si.priceSum);writeChar(' ');
+            writeInt(dayTrainS.querySeat(si.index, k - 1));writeChar('\n');
+            write(stationIndex.train(ti.trainNo).trainID);writeChar(' ');
+            write(stationIndex.name(routeT[l].station));writeChar(' ');
+            writeTime(best.startDay2 + routeT[l].leavingTime);write(" -> ");
+            write(stationIndex.name(tId));writeChar(' ');
+            writeTime(best.startDay2 + ti.arrivingTime);writeChar(' ');
+            writeInt(ti.priceSum - routeT[l].priceSum);writeChar(' ');
+            writeInt(dayTrainT.querySeat(l, ti.index - 1));
+            return 1;
         }
 
         int buy_ticket(const cmdType& info) {
             if (info.argNum < 6 || info.argNum > 7) return -1;
             uidType uid = info.args['u'-'a'];
-            hashCode uidHash = hash(uid.str);
-            if (loggedUser.find(uidHash) == -1) return -1; //未登录
-            TimeType day = info.args['d'-'a'] + " 00:00";
+            auto session = findSession(uid);
+            if (!session) return -1; //未登录
+            hashCode uidHash = session->key;
+            TimeType day = TimeType::fromDate(info.args['d'-'a']);
             tidType id = info.args['i'-'a'];
-            hashCode idHash = hash(id.str);
-            auto train = trainDatabase.find(idHash);
+            auto target = findTrain(id);
+            auto cached = target.cached;
+            hashCode idHash = target.key;
             int buyNum = stringToInt(info.args['n'-'a']);
-            if (!train.second || !train.first.isReleased || buyNum > train.first.totalSeatNum) return -1;
-            int f = -1, t = -1;
-            for (int i = 0; i < train.first.stationNum && (f == -1 || t == -1); ++i) {
-                if (train.first.stations[i] == info.args['f'-'a']) f = i;
-                if (train.first.stations[i] == info.args['t'-'a']) t = i;
-            }
+            if (!cached || !cached->train.isReleased || buyNum > cached->train.totalSeatNum) return -1;
+            const Train& train = cached->train;
+            int f = cached->indexOf(staNameType(info.args['f'-'a'])), t = cached->indexOf(staNameType(info.args['t'-'a']));
             if (f == -1 || t == -1 || f >= t) return -1;
-            TimeType startDay = day - train.first.leavingTimes[f].getDate();
-            if (!(train.first.startSaleDate <= startDay && startDay <= train.first.endSaleDate)) return -1;
-            auto dayTrain = dayTrainDatabase.find(std::make_pair(startDay, idHash));
-            int remainSeat = dayTrain.first.querySeat(f, t-1);
+            TimeType startDay = day - train.leavingTimes[f].getDate();
+            if (!(train.startSaleDate <= startDay && startDay <= train.endSaleDate)) return -1;
+            auto dayTrain = getDayTrain(idHash, startDay);
+            int remainSeat = dayTrain.querySeat(f, t-1);
             if ((info.argNum != 7 || info.args['q'-'a'] == "false") && remainSeat < buyNum) return -1;
-            int price = train.first.priceSum[t]-train.first.priceSum[f], oid = orderDatabase.size();
-            Order order = (Order){SUCCESS, id, uid, f, t, train.first.stations[f], train.first.stations[t], startDay, train.first.leavingTimes[f], train.first.arrivingTimes[t], oid, price, buyNum};
+            int price = train.priceSum[t]-train.priceSum[f], oid = orderDatabase.size();
+            Order order = (Order){SUCCESS, stationIndex.trainNoOf(idHash), f, t, startDay, oid, buyNum};
             if (remainSeat >= buyNum) {
-                dayTrain.first.modifySeat(f, t-1, -buyNum);
-                dayTrainDatabase.modify(std::make_pair(startDay, idHash), dayTrain.first);
+                dayTrain.modifySeat(f, t-1, -buyNum);
+                putDayTrain(dayTrain);
                 orderDatabase.insert(std::make_pair(uidHash, oid), order);
-                long long ret = (long long)price*buyNum;
-                write(std::to_string(ret).c_str());
+                writeInt((long long)price*buyNum);
                 return 1;
             }
             order.status = PENDING;
             orderDatabase.insert(std::make_pair(uidHash, oid), order);
-            pendingQueue.insert(std::make_pair(std::make_pair(startDay, idHash), oid), (PendingOrder){idHash, uidHash, f, t, oid, buyNum, startDay});
+            waitlistDatabase.insert((WaitKey){startDay, idHash, f, t, oid}, (PendingOrder){uidHash, f, t, oid, buyNum});
             write("queue");
             return 1;
         }
@@ -489,26 +820,30 @@ namespace Sirius {
         int query_order(const cmdType& info) {
             if (info.argNum != 1) return -1;
             uidType uid = info.args['u'-'a'];
-            hashCode uidHash = hash(uid.str);
-            if (loggedUser.find(uidHash) == -1) return -1;
-            int orderLen = 0;
-            orderDatabase.range_find(std::make_pair(uidHash, 0), std::make_pair(uidHash, Int_Max), orders, orderLen);
+            auto session = findSession(uid);
+            if (!session) return -1;
+            hashCode uidHash = session->key;
+            ArenaArray<Order> orders(tempArena());
+            orderDatabase.range_find(std::make_pair(uidHash, 0), std::make_pair(uidHash, Int_Max), [&]() {return orders.emplace();});
+            int orderLen = orders.size();
             if (!orderLen) return 0;
             writeInt(orderLen);
             for (int i = orderLen-1; i >= 0; --i) {
-                putchar('\n');
-                auto it = orders+i;
+                writeChar('\n');
+                auto it = orders.begin()+i;
                 switch (it->status) {
                     case SUCCESS:write("[success] ");break;
                     case PENDING:write("[pending] ");break;
                     case REFUNDED:write("[refunded] ");
                 }
-                write(it->trainID.str), putchar(' ');
-                write(it->from.str), putchar(' ');
-                write((it->startDay+it->leavingTime).toFormatString().c_str()), putchar(' '), putchar('-'), putchar('>'), putchar(' ');
-                write(it->to.str), putchar(' ');
-                write((it->startDay+it->arrivingTime).toFormatString().c_str()), putchar(' ');
-                writeInt(it->price), putchar(' ');
+                const auto& route = stationIndex.routeOf(it->trainNo);
+                const auto &from = route[it->fromIndex], &to = route[it->toIndex];
+                write(stationIndex.train(it->trainNo).trainID), writeChar(' ');
+                write(stationIndex.name(from.station)), writeChar(' ');
+                writeTime(it->startDay+from.leavingTime), writeChar(' '), writeChar('-'), writeChar('>'), writeChar(' ');
+                write(stationIndex.name(to.station)), writeChar(' ');
+                writeTime(it->startDay+to.arrivingTime), writeChar(' ');
+                writeInt(to.priceSum - from.priceSum), writeChar(' ');
                 writeInt(it->num);
             }
             return 1;
@@ -517,33 +852,52 @@ namespace Sirius {
         int refund_ticket(const cmdType& info) {
             if (info.argNum < 1 || info.argNum > 2) return -1;
             uidType uid = info.args['u'-'a'];
-            hashCode uidHash  = hash(uid.str);
-            if (loggedUser.find(uidHash) == -1) return -1;
-            int orderLen = 0;
-            orderDatabase.range_find(std::make_pair(uidHash, 0), std::make_pair(uidHash, Int_Max), orders, orderLen);
+            auto session = findSession(uid);
+            if (!session) return -1;
+            hashCode uidHash = session->key;
+            ArenaArray<Order> orders(tempArena());
+            orderDatabase.range_find(std::make_pair(uidHash, 0), std::make_pair(uidHash, Int_Max), [&]() {return orders.emplace();});
+            int orderLen = orders.size();
             int n = (info.args['n'-'a'].empty()) ? 1 : stringToInt(info.args['n'-'a']);
             if (n > orderLen) return -1;
-            auto it = orders + orderLen - n;
+            auto it = orders.begin() + orderLen - n;
             if (it->status == REFUNDED) return -1;
             orderDatabase.modify_info(std::make_pair(uidHash, it->orderID), REFUNDED, 0);
+            hashCode idHash = stationIndex.train(it->trainNo).tidHash;
             if (it->status == PENDING) {
-                pendingQueue.erase(std::make_pair(std::make_pair(it->startDay, hash(it->trainID.str)), it->orderID));
+                waitlistDatabase.erase((WaitKey){it->startDay, idHash, it->fromIndex, it->toIndex, it->orderID});
                 return 0;
             }
-            hashCode idHash = hash(it->trainID.str);
-            auto dayTrain = dayTrainDatabase.find(std::make_pair(it->startDay, idHash));
-            dayTrain.first.modifySeat(it->fromIndex, it->toIndex-1, it->num);
-            int roLen = 0;
-            pendingQueue.range_find(std::make_pair(std::make_pair(it->startDay, hash(it->trainID.str)), 0), std::make_pair(std::make_pair(it->startDay, hash(it->trainID.str)), Int_Max), refundOrders, roLen);
-            for (auto i = refundOrders; i != refundOrders + roLen; i++) {
-                if (i->fromIndex > it->toIndex || i->toIndex < it->fromIndex) continue;
-                if (dayTrain.first.querySeat(i->fromIndex, i->toIndex-1) >= i->num) {
-                    dayTrain.first.modifySeat(i->fromIndex, i->toIndex-1, -i->num);
-                    pendingQueue.erase(std::make_pair(std::make_pair(i->startDay, i->tidHash), i->orderID));
-                    orderDatabase.modify_info(std::make_pair(i->uidHash, i->orderID), SUCCESS, 0);
+            auto dayTrain = getDayTrain(idHash, it->startDay);
+            dayTrain.modifySeat(it->fromIndex, it->toIndex-1, it->num);
+            //fromIndex < toIndex 的候补一次取出（按键有序），只看和 [fromIndex, toIndex) 有重叠的 (fromIndex, toIndex) 段，按 orderID 多路归并，保持先到先得
+            ArenaArray<PendingOrder> pending(tempArena());
+            waitlistDatabase.range_find((WaitKey){it->startDay, idHash, 0, 0, 0}, (WaitKey){it->startDay, idHash, it->toIndex-1, Int_Max, Int_Max},
+                                        [&]() {return pending.emplace();});
+            Heap<std::pair<int, int>> heads; //(orderID, 位置)
+            Vector<int> runEnd; //runEnd[i]: i 所在段的末尾
+            runEnd.resize(pending.size());
+            for (int i = 0, j; i < pending.size(); i = j) {
+                for (j = i; j < pending.size() && pending[j].fromIndex == pending[i].fromIndex && pending[j].toIndex == pending[i].toIndex; ++j);
+                if (pending[i].toIndex > it->fromIndex) runEnd[i] = j, heads.push(std::make_pair(pending[i].orderID, i));
+            }
+            Vector<std::pair<hashCode, int>> fulfilled; //补上的订单，最后一起改状态
+            while (!heads.empty()) {
+                int pos = heads.top().second;
+                heads.pop();
+                const auto& order = pending[pos];
+                if (dayTrain.querySeat(order.fromIndex, order.toIndex-1) >= order.num) {
+                    dayTrain.modifySeat(order.fromIndex, order.toIndex-1, -order.num);
+                    waitlistDatabase.erase((WaitKey){it->startDay, idHash, order.fromIndex, order.toIndex, order.orderID});
+                    fulfilled.push_back(std::make_pair(order.uidHash, order.orderID));
                 }
+                if (pos + 1 < runEnd[pos]) runEnd[pos+1] = runEnd[pos], heads.push(std::make_pair(pending[pos+1].orderID, pos+1));
+            }
+            if (!fulfilled.empty()) { //按键排好，同一叶子上的一起改
+                introSort(fulfilled.begin(), fulfilled.end(), [](const std::pair<hashCode, int>& a, const std::pair<hashCode, int>& b) {return a < b;});
+                orderDatabase.batch_modify_info(fulfilled.begin(), fulfilled.size(), SUCCESS, 0);
             }
-            dayTrainDatabase.modify(std::make_pair(it->startDay, idHash), dayTrain.first);
+            putDayTrain(dayTrain);
             return 0;
         }
 
@@ -551,10 +905,13 @@ namespace Sirius {
             loggedUser.clear();
             userDatabase.clear();
             trainDatabase.clear();
-            dayTrainDatabase.clear();
-            stationDatabase.clear();
+            trainCache.clear();
+            resultCache.clear();
+            seatMatrix.clear();
+            stationIndex.clear();
+            routeViews.clear();
             orderDatabase.clear();
-            pendingQueue.clear();
+            waitlistDatabase.clear();
             return 0;
         }
         int exit(const cmdType& info) {
@@ -562,6 +919,7 @@ namespace Sirius {
             return 2;
         }
     };
+    thread_local System::ReadContext* System::readCtx = nullptr;
 }
 
 #endif //TICKETSYSTEM_2021_MAIN_SYSTEMCORE_HPP
\ No newline at end of file